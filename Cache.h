@@ -36,10 +36,23 @@ extern uint64_t hash_size;
 
 
 /*
- * size of Transposition is 13 bytes
+ * size of Transposition is 16 bytes
+ *
+ * The entry is stored in two 64-bit words, the data and the hash key xor:ed with the data. (lockless hashing)
+ * Several threads may write the same entry at the same time without locks. If the words are from different
+ * writes, the key does not verify and the entry is treated as empty.
+ *
+ * data: next_move bit 0-27, type bit 28-29, depth bit 30-37, generation bit 38-45, score bit 46-61
  */
 struct Transposition {
-	uint32_t hash = 0;
+	uint64_t key = 0;
+	uint64_t data = 0;
+};
+
+/*
+ * an unpacked transposition
+ */
+struct TTData {
 	uint32_t next_move = 0;
 	uint8_t depth = 0;
 	uint8_t type = 0;
@@ -47,38 +60,80 @@ struct Transposition {
 	uint8_t generation = 0;
 };
 
+inline uint64_t pack_tt_data(const TTData& t) {
+	return (t.next_move & 0xfffffffULL)
+			| ((uint64_t) (t.type & 0x3) << 28)
+			| ((uint64_t) t.depth << 30)
+			| ((uint64_t) t.generation << 38)
+			| ((uint64_t) (uint16_t) t.score << 46);
+}
 
-#define hash_verification(h) ((uint32_t)(h >> 32))
+inline TTData unpack_tt_data(const uint64_t data) {
+	TTData t;
+	t.next_move = data & 0xfffffff;
+	t.type = (data >> 28) & 0x3;
+	t.depth = (data >> 30) & 0xff;
+	t.generation = (data >> 38) & 0xff;
+	t.score = (int16_t) ((data >> 46) & 0xffff);
+	return t;
+}
+
+inline uint64_t tt_bucket_start_index(const uint64_t& hash_key) {
+	return TT_BUCKET_SIZE * ((uint32_t) ((hash_key)) & ((hash_size - 1) / TT_BUCKET_SIZE));
+}
 
 /*
  * probes the transposition table
  *
- * returns a hit(same verifcation and the bucket) or a pointer to the element that should be replaced in the bucket
+ * returns true on a hit (a verified entry for the hash key in the bucket) and the entry in hit
+ */
+inline bool probe_tt(Transposition *tt, const uint64_t& hash_key, TTData& hit) {
+	uint64_t bucket_start_index = tt_bucket_start_index(hash_key);
+	for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+		// read each word once, another thread may be writing the entry
+		uint64_t key = tt[bucket_start_index + i].key;
+		uint64_t data = tt[bucket_start_index + i].data;
+		if ((key ^ data) == hash_key) {
+			hit = unpack_tt_data(data);
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * stores an entry in the transposition table
  *
- * replaces the element with the lowest depth and the lowest generation
+ * replaces the entry with the same hash key, or else the element with the lowest depth and the lowest generation
  *
  */
-inline Transposition* probe_tt(Transposition *tt, const uint64_t& hash_key, const uint8_t& generation) {
-	uint64_t bucket_start_index = TT_BUCKET_SIZE * ((uint32_t) ((hash_key)) & ((hash_size - 1) / TT_BUCKET_SIZE));
+inline void store_tt(Transposition *tt, const uint64_t& hash_key, const TTData& t) {
+	uint64_t bucket_start_index = tt_bucket_start_index(hash_key);
 	uint64_t tt_index = bucket_start_index;
 	uint8_t lowest_depth = 32;
 	uint8_t lowest_generation = 255;
 	for (int i = 0; i < TT_BUCKET_SIZE; i++) {
-		if (tt[bucket_start_index + i].hash == hash_verification(hash_key)) {
-			return &tt[bucket_start_index + i];
+		uint64_t key = tt[bucket_start_index + i].key;
+		uint64_t data = tt[bucket_start_index + i].data;
+		if ((key ^ data) == hash_key) {
+			tt_index = bucket_start_index + i;
+			break;
 		}
-		if (tt[bucket_start_index + i].generation <= lowest_generation) {
-			if (tt[bucket_start_index + i].generation < lowest_generation) {
+		TTData entry = unpack_tt_data(data);
+		if (entry.generation <= lowest_generation) {
+			if (entry.generation < lowest_generation) {
 				lowest_depth = 32;
 			}
-			if (tt[bucket_start_index + i].depth <= lowest_depth) {
+			if (entry.depth <= lowest_depth) {
 				tt_index = bucket_start_index + i;
-				lowest_depth = tt[bucket_start_index + i].depth;
+				lowest_depth = entry.depth;
 			}
-			lowest_generation = tt[bucket_start_index + i].generation;
+			lowest_generation = entry.generation;
 		}
 	}
-	return &tt[tt_index];
+	uint64_t data = pack_tt_data(t);
+	tt[tt_index].key = hash_key ^ data;
+	tt[tt_index].data = data;
 }
 
 inline uint64_t get_hash_table_size(int hash_size_mb) {
@@ -92,7 +147,7 @@ inline uint64_t get_hash_table_size(int hash_size_mb) {
 inline int hashfull(Transposition *tt) {
 	int count = 0;
 	for (unsigned int i = 0; i < 1000; i++) {
-		if (tt[i+i].hash != 0) {
+		if (tt[i+i].data != 0) {
 			count++;
 		}
 	}
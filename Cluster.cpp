@@ -0,0 +1,358 @@
+/*
+ * Gunborg - UCI chess engine
+ * Copyright (C) 2013-2015 Torbjörn Nilsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Cluster.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Torbjörn Nilsson
+ */
+
+#include "Cluster.h"
+#include "board.h"
+#include "uci.h"
+#include "util.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#ifdef __linux__
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace gunborg {
+
+namespace {
+
+// time to wait for the best move of a worker after stop
+const int STOP_TIMEOUT_MS = 10000;
+
+#ifdef __linux__
+/*
+ * a connected (listen = false) or listening (listen = true) socket for a unix socket path or [host:]port,
+ * -1 on failure
+ */
+int open_socket(const std::string& address, bool listen) {
+	if (address.find('/') != std::string::npos) {
+		sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (address.size() >= sizeof(addr.sun_path)) {
+			return -1;
+		}
+		strcpy(addr.sun_path, address.c_str());
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0) {
+			return -1;
+		}
+		if (listen) {
+			unlink(address.c_str());
+		}
+		int result = listen ? bind(fd, (sockaddr*) &addr, sizeof(addr)) : ::connect(fd, (sockaddr*) &addr, sizeof(addr));
+		if (result != 0 || (listen && ::listen(fd, 1) != 0)) {
+			close(fd);
+			return -1;
+		}
+		return fd;
+	}
+	std::string::size_type colon = address.rfind(':');
+	std::string host = colon != std::string::npos ? address.substr(0, colon) : "127.0.0.1";
+	std::string port = colon != std::string::npos ? address.substr(colon + 1) : address;
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = listen ? AI_PASSIVE : 0;
+	addrinfo* addresses = NULL;
+	if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+		return -1;
+	}
+	int fd = -1;
+	for (addrinfo* a = addresses; a != NULL && fd < 0; a = a->ai_next) {
+		fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if (fd < 0) {
+			continue;
+		}
+		int reuse = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+		int result = listen ? bind(fd, a->ai_addr, a->ai_addrlen) : ::connect(fd, a->ai_addr, a->ai_addrlen);
+		if (result != 0 || (listen && ::listen(fd, 1) != 0)) {
+			close(fd);
+			fd = -1;
+		}
+	}
+	freeaddrinfo(addresses);
+	return fd;
+}
+#endif
+
+}
+
+bool Cluster::connect(const std::string& addresses) {
+	disconnect();
+#ifdef __linux__
+	std::stringstream ss(addresses);
+	std::string address;
+	while (getline(ss, address, ',')) {
+		if (address.empty()) {
+			continue;
+		}
+		int fd = open_socket(address, false);
+		if (fd < 0) {
+			disconnect();
+			return false;
+		}
+		ClusterWorker* worker = new ClusterWorker();
+		worker->fd = fd;
+		worker->connected = true;
+		worker->reader = std::thread(&Cluster::read_output, this, worker);
+		workers.push_back(worker);
+	}
+	return true;
+#else
+	return addresses.empty();
+#endif
+}
+
+void Cluster::disconnect() {
+#ifdef __linux__
+	for (unsigned int i = 0; i < workers.size(); i++) {
+		ClusterWorker* worker = workers[i];
+		send(i, "quit");
+		// the reader sees the end of the stream and returns
+		shutdown(worker->fd, SHUT_RDWR);
+		worker->reader.join();
+		close(worker->fd);
+		delete worker;
+	}
+#endif
+	workers.clear();
+}
+
+int Cluster::size() {
+	return workers.size();
+}
+
+void Cluster::send(int worker_index, const std::string& line) {
+#ifdef __linux__
+	ClusterWorker* worker = workers[worker_index];
+	std::string data = line + "\n";
+	std::lock_guard<std::mutex> guard(worker->send_lock);
+	for (size_t sent = 0; sent < data.size(); ) {
+		ssize_t n = ::send(worker->fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+		if (n <= 0) {
+			return;
+		}
+		sent += n;
+	}
+#endif
+}
+
+void Cluster::clear_results() {
+	for (auto worker : workers) {
+		std::lock_guard<std::mutex> guard(worker->lock);
+		worker->node_count = 0;
+		worker->last_depth = 0;
+		worker->results.clear();
+	}
+}
+
+void Cluster::start(int worker_index, const std::string& position_line, const std::string& go_line) {
+	ClusterWorker* worker = workers[worker_index];
+	{
+		std::lock_guard<std::mutex> guard(worker->lock);
+		if (!worker->connected) {
+			return;
+		}
+		worker->searching = true;
+		worker->stop_sent = false;
+		worker->node_count = 0;
+		worker->last_depth = 0;
+		worker->finished_last_depth = false;
+		worker->results.clear();
+	}
+	send(worker_index, position_line);
+	send(worker_index, go_line);
+}
+
+void Cluster::finish(const std::atomic_bool& should_run) {
+	bool stopped = false;
+	std::chrono::steady_clock::time_point stop_time;
+	while (true) {
+		if (!should_run && !stopped) {
+			for (unsigned int i = 0; i < workers.size(); i++) {
+				bool searching;
+				{
+					std::lock_guard<std::mutex> guard(workers[i]->lock);
+					searching = workers[i]->searching;
+					workers[i]->stop_sent = true;
+				}
+				if (searching) {
+					send(i, "stop");
+				}
+			}
+			stopped = true;
+			stop_time = std::chrono::steady_clock::now();
+		}
+		bool searching = false;
+		for (auto worker : workers) {
+			std::lock_guard<std::mutex> guard(worker->lock);
+			if (worker->searching && stopped && std::chrono::steady_clock::now() - stop_time
+					> std::chrono::milliseconds(STOP_TIMEOUT_MS)) {
+				// a worker that does not answer is left out of the results
+				worker->searching = false;
+				worker->results.clear();
+			}
+			searching = searching || worker->searching;
+		}
+		if (!searching) {
+			return;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+}
+
+uint64_t Cluster::node_count() {
+	uint64_t nodes = 0;
+	for (auto worker : workers) {
+		std::lock_guard<std::mutex> guard(worker->lock);
+		nodes += worker->node_count;
+	}
+	return nodes;
+}
+
+int Cluster::completed_depth(int max_depth) {
+	int depth = max_depth;
+	for (auto worker : workers) {
+		std::lock_guard<std::mutex> guard(worker->lock);
+		if (worker->results.empty()) {
+			continue;
+		}
+		// the last depth is not completed if the worker was stopped during it
+		int worker_depth = worker->finished_last_depth ? worker->last_depth : worker->last_depth - 1;
+		depth = std::min(depth, worker_depth);
+	}
+	return depth;
+}
+
+bool Cluster::best_result(int depth, ClusterResult& result) {
+	bool found = false;
+	for (auto worker : workers) {
+		std::lock_guard<std::mutex> guard(worker->lock);
+		if (depth < (int) worker->results.size() && worker->results[depth].depth == depth
+				&& (!found || worker->results[depth].score > result.score)) {
+			result = worker->results[depth];
+			found = true;
+		}
+	}
+	return found;
+}
+
+void Cluster::read_output(ClusterWorker* worker) {
+#ifdef __linux__
+	std::string buffer;
+	char data[4096];
+	while (true) {
+		ssize_t n = recv(worker->fd, data, sizeof(data), 0);
+		if (n <= 0) {
+			break;
+		}
+		buffer.append(data, n);
+		std::string::size_type end;
+		while ((end = buffer.find('\n')) != std::string::npos) {
+			parse_line(worker, buffer.substr(0, end));
+			buffer.erase(0, end + 1);
+		}
+	}
+	std::lock_guard<std::mutex> guard(worker->lock);
+	worker->connected = false;
+	worker->searching = false;
+#endif
+}
+
+void Cluster::parse_line(ClusterWorker* worker, const std::string& line) {
+	std::lock_guard<std::mutex> guard(worker->lock);
+	if (!worker->searching) {
+		return;
+	}
+	if (line.find("bestmove") == 0) {
+		worker->searching = false;
+		// if the worker ended the search by itself the last depth was completed
+		worker->finished_last_depth = !worker->stop_sent;
+		return;
+	}
+	std::string::size_type pv_pos = line.find(" pv ");
+	if (line.find("info") != 0 || pv_pos == std::string::npos) {
+		return;
+	}
+	ClusterResult result;
+	result.depth = parse_int_parameter(line, "depth");
+	result.score = parse_int_parameter(line, "cp");
+	result.pv = line.substr(pv_pos + 4);
+	if (result.depth <= 0) {
+		return;
+	}
+	if ((int) worker->results.size() <= result.depth) {
+		worker->results.resize(result.depth + 1);
+	}
+	worker->results[result.depth] = result;
+	worker->last_depth = std::max(worker->last_depth, result.depth);
+	std::string::size_type nodes_pos = line.find("nodes ");
+	if (nodes_pos != std::string::npos) {
+		worker->node_count = strtoull(line.c_str() + nodes_pos + 6, NULL, 10);
+	}
+}
+
+Cluster::~Cluster() {
+	disconnect();
+}
+
+void serve_worker(const std::string& address) {
+#ifdef __linux__
+	int listen_fd = open_socket(address, true);
+	if (listen_fd < 0) {
+		std::cout << "could not listen on " << address << "\n";
+		return;
+	}
+	std::cout << "worker listening on " << address << "\n" << std::flush;
+	while (true) {
+		int fd = accept(listen_fd, NULL, NULL);
+		if (fd < 0) {
+			continue;
+		}
+		// the coordinator talks uci with this process through the socket
+		std::cout << std::flush;
+		dup2(fd, 0);
+		dup2(fd, 1);
+		close(fd);
+		clearerr(stdin);
+		std::cin.clear();
+		uci();
+		std::cout << std::flush;
+	}
+#else
+	std::cout << "worker mode is not supported on this platform\n";
+#endif
+}
+
+} /* namespace gunborg */
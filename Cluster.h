@@ -0,0 +1,129 @@
+/*
+ * Gunborg - UCI chess engine
+ * Copyright (C) 2013-2015 Torbjörn Nilsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Cluster.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Torbjörn Nilsson
+ */
+
+#ifndef CLUSTER_H_
+#define CLUSTER_H_
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace gunborg {
+
+/*
+ * the best score and pv of a search at one depth
+ */
+struct ClusterResult {
+	int depth = 0;
+	int score = 0;
+	std::string pv;
+};
+
+/*
+ * A gunborg process searching some of the root moves for the coordinator, connected with a socket.
+ *
+ * Everything below the lock is written by the thread reading the output of the worker
+ */
+struct ClusterWorker {
+	int fd = -1;
+	std::thread reader;
+	std::mutex send_lock;
+
+	std::mutex lock;
+	bool connected = false;
+	bool searching = false;
+	bool stop_sent = false;
+	uint64_t node_count = 0;
+	int last_depth = 0;
+	bool finished_last_depth = false;
+	std::vector<ClusterResult> results; // the last info line at each depth
+};
+
+/*
+ * The coordinator side of a cluster search. The root moves are divided between the coordinator and the
+ * workers with go searchmoves, and the info lines of the workers are merged into the output of the coordinator.
+ */
+class Cluster {
+
+private:
+	std::vector<ClusterWorker*> workers;
+
+	void read_output(ClusterWorker* worker);
+	void parse_line(ClusterWorker* worker, const std::string& line);
+
+public:
+	/*
+	 * connects to the comma separated workers, each one is a unix socket path or [host:]port.
+	 * Returns false, and is not connected to any worker, if a connection fails
+	 */
+	bool connect(const std::string& addresses);
+	void disconnect();
+
+	int size();
+
+	void send(int worker_index, const std::string& line);
+
+	/*
+	 * forgets the results of the last search, before the workers of the next search are started
+	 */
+	void clear_results();
+
+	/*
+	 * sends the position and go command to the worker and starts collecting its results
+	 */
+	void start(int worker_index, const std::string& position_line, const std::string& go_line);
+
+	/*
+	 * waits for the best moves of the searching workers. The workers are stopped when should_run is false
+	 */
+	void finish(const std::atomic_bool& should_run);
+
+	/*
+	 * nodes searched by the searching workers
+	 */
+	uint64_t node_count();
+
+	/*
+	 * the deepest depth that all searching workers have completed, max_depth if none is searching
+	 */
+	int completed_depth(int max_depth);
+
+	/*
+	 * the best result of the searching workers at depth, false if no worker has a result at depth
+	 */
+	bool best_result(int depth, ClusterResult& result);
+
+	virtual ~Cluster();
+};
+
+/*
+ * Runs the uci loop for coordinators connecting to address, a unix socket path or [host:]port. Without host
+ * only connections from this host are accepted.
+ */
+void serve_worker(const std::string& address);
+
+} /* namespace gunborg */
+#endif /* CLUSTER_H_ */
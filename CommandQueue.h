@@ -0,0 +1,109 @@
+/*
+ * Gunborg - UCI chess engine
+ * Copyright (C) 2013-2015 Torbjörn Nilsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * CommandQueue.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Torbjörn Nilsson
+ */
+
+#ifndef COMMANDQUEUE_H_
+#define COMMANDQUEUE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+/*
+ * a uci command and its position in the input, later commands have higher sequence numbers
+ */
+struct Command {
+	std::string line;
+	uint64_t sequence = 0;
+};
+
+/*
+ * Lock-free ring buffer of commands with a single producer (the stdin reader) and a single consumer
+ * (the engine thread). The mutex is only used to park the consumer when the queue is empty.
+ */
+class CommandQueue {
+
+private:
+	static const unsigned int CAPACITY = 256;
+	Command commands[CAPACITY];
+	std::atomic<unsigned int> head; // next command to pop, only written by the consumer
+	std::atomic<unsigned int> tail; // next free slot, only written by the producer
+	std::mutex lock;
+	std::condition_variable not_empty;
+
+public:
+	CommandQueue() : head(0), tail(0) {
+	}
+
+	bool try_push(const Command& command) {
+		unsigned int t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == CAPACITY) {
+			return false;
+		}
+		commands[t % CAPACITY] = command;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool try_pop(Command& command) {
+		unsigned int h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		command = commands[h % CAPACITY];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	/*
+	 * pushes the command and wakes the consumer. Yields while the queue is full
+	 */
+	void push(const Command& command) {
+		while (!try_push(command)) {
+			std::this_thread::yield();
+		}
+		{
+			// taking the lock makes sure the consumer is either waiting or has not yet checked the queue
+			std::lock_guard<std::mutex> guard(lock);
+		}
+		not_empty.notify_one();
+	}
+
+	/*
+	 * pops the oldest command, parks until there is one
+	 */
+	Command pop() {
+		Command command;
+		while (!try_pop(command)) {
+			std::unique_lock<std::mutex> guard(lock);
+			if (head.load() == tail.load()) {
+				not_empty.wait(guard);
+			}
+		}
+		return command;
+	}
+};
+
+#endif /* COMMANDQUEUE_H_ */
@@ -22,6 +22,7 @@
  */
 
 #include "board.h"
+#include "Cluster.h"
 #include "eval.h"
 #include "Main.h"
 #include "moves.h"
@@ -40,8 +41,6 @@ namespace {
 int main(int argc, char* argv[]) {
 	std::cout << fixed;
 	std::cout << setprecision(2);
-	init();
-	init_eval();
 
 	std::cout << "Gunborg Copyright (C) 2013-2015 Torbjörn Nilsson\n"
 			<< "This program comes with ABSOLUTELY NO WARRANTY; for details type `show w'.\n"
@@ -50,6 +49,9 @@ int main(int argc, char* argv[]) {
 
 	if (argc == 2 && strcmp(argv[1], "test") == 0) {
 		run_tests();
+	} else if (argc == 3 && strcmp(argv[1], "worker") == 0) {
+		// a worker of cluster searches, argv[2] is a unix socket path or [host:]port
+		gunborg::serve_worker(argv[2]);
 	} else {
 		uci();
 	}
@@ -0,0 +1,243 @@
+/*
+ * Gunborg - UCI chess engine
+ * Copyright (C) 2013-2015 Torbjörn Nilsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * MovePicker.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Torbjörn Nilsson
+ */
+
+#include "MovePicker.h"
+#include <algorithm>
+#include <limits.h>
+
+namespace gunborg {
+
+namespace {
+
+// captures with a sort score below this lose material
+const int WINNING_CAPTURE_SCORE = 1000000;
+const int KILLER_SCORES[2] = { 999999, 899999 };
+// quiet moves that give check are picked before the other quiet moves
+const int CHECK_SCORE = 500000;
+
+/*
+ * swaps the move with the highest sort score in [first, last) to first, the first one of equal scores like
+ * pick_next_move
+ */
+void pick_best(MoveList& moves, unsigned int first, unsigned int last) {
+	int max_sort_score = INT_MIN;
+	unsigned int max_index = first;
+	for (unsigned int i = first; i < last; i++) {
+		if (moves[i].sort_score > max_sort_score) {
+			max_index = i;
+			max_sort_score = moves[i].sort_score;
+		}
+	}
+	std::swap(moves[first], moves[max_index]);
+}
+
+}
+
+MovePicker::MovePicker(const Position& position, const bool white_turn, const CheckInfo& check, uint32_t hash_move,
+		const Move (&killers)[2], const uint64_t (&history)[64][64]) :
+		position(position), white_turn(white_turn), check(check), hash_move(hash_move), killers(killers), history(
+				history) {
+	if (check.checkers) {
+		stage = GENERATE_EVASIONS;
+	}
+}
+
+bool MovePicker::is_picked_before(uint32_t move) const {
+	return move == hash_move || move == killers[0].m || move == killers[1].m;
+}
+
+bool MovePicker::is_valid_killer(unsigned int index) const {
+	uint32_t killer = killers[index].m;
+	return killer != 0 && killer != hash_move && !is_capture(killer) && (index == 0 || killer != killers[0].m)
+			&& is_pseudo_legal(position, white_turn, killer) && is_legal(position, check, killer);
+}
+
+void MovePicker::score_evasions() {
+	for (auto& evasion : evasions) {
+		if (evasion.m == hash_move) {
+			evasion.sort_score = INT_MAX;
+		} else if (is_capture(evasion.m)) {
+			if (evasion.sort_score < WINNING_CAPTURE_SCORE) {
+				evasion.sort_score -= 2 * WINNING_CAPTURE_SCORE;
+			}
+		} else if (evasion.m == killers[0].m) {
+			evasion.sort_score = KILLER_SCORES[0];
+		} else if (evasion.m == killers[1].m) {
+			evasion.sort_score = KILLER_SCORES[1];
+		} else {
+			evasion.sort_score += history[from_square(evasion.m)][to_square(evasion.m)];
+		}
+	}
+}
+
+void MovePicker::score_quiet_moves() {
+	for (auto& quiet_move : quiet_moves) {
+		// "history heuristics"
+		// the quite moves are sorted based on how often they increase score in the search tree
+		quiet_move.sort_score += history[from_square(quiet_move.m)][to_square(quiet_move.m)];
+		if (gives_check(position, check, quiet_move.m)) {
+			quiet_move.sort_score += CHECK_SCORE;
+		}
+	}
+}
+
+bool MovePicker::next_move(Move& move) {
+	while (true) {
+		switch (stage) {
+		case HASH_MOVE:
+			stage = GENERATE_CAPTURES;
+			if (hash_move != 0 && is_pseudo_legal(position, white_turn, hash_move) && is_legal(position, check, hash_move)) {
+				move.m = hash_move;
+				move.sort_score = 0;
+				return true;
+			}
+			break;
+		case GENERATE_CAPTURES:
+			captures = get_captures(position, white_turn);
+			stage = WINNING_CAPTURES;
+			break;
+		case WINNING_CAPTURES:
+			while (next_capture < captures.size()) {
+				pick_best(captures, next_capture, captures.size());
+				if (captures[next_capture].sort_score < WINNING_CAPTURE_SCORE) {
+					// the losing captures are left for the last stage
+					break;
+				}
+				move = captures[next_capture++];
+				if (move.m != hash_move && is_legal(position, check, move.m)) {
+					return true;
+				}
+			}
+			stage = KILLER_MOVES;
+			break;
+		case KILLER_MOVES:
+			while (killer_index < 2) {
+				unsigned int index = killer_index++;
+				if (is_valid_killer(index)) {
+					move.m = killers[index].m;
+					move.sort_score = KILLER_SCORES[index];
+					return true;
+				}
+			}
+			stage = GENERATE_QUIET_MOVES;
+			break;
+		case GENERATE_QUIET_MOVES:
+			quiet_moves = get_quiet_moves(position, white_turn);
+			score_quiet_moves();
+			stage = QUIET_MOVES;
+			break;
+		case QUIET_MOVES:
+			while (next_quiet_move < quiet_moves.size()) {
+				pick_best(quiet_moves, next_quiet_move, quiet_moves.size());
+				move = quiet_moves[next_quiet_move++];
+				if (!is_picked_before(move.m) && is_legal(position, check, move.m)) {
+					return true;
+				}
+			}
+			stage = LOSING_CAPTURES;
+			break;
+		case LOSING_CAPTURES:
+			while (next_capture < captures.size()) {
+				pick_best(captures, next_capture, captures.size());
+				move = captures[next_capture++];
+				if (move.m != hash_move && is_legal(position, check, move.m)) {
+					return true;
+				}
+			}
+			stage = NO_MOVES_LEFT;
+			break;
+		case GENERATE_EVASIONS:
+			evasions = get_evasions(position, white_turn, check);
+			score_evasions();
+			stage = EVASIONS;
+			break;
+		case EVASIONS:
+			if (next_evasion < evasions.size()) {
+				pick_best(evasions, next_evasion, evasions.size());
+				move = evasions[next_evasion++];
+				return true;
+			}
+			stage = NO_MOVES_LEFT;
+			break;
+		default:
+			return false;
+		}
+	}
+}
+
+void MovePicker::remaining_moves(MoveList& moves) {
+	if (stage == GENERATE_EVASIONS || stage == EVASIONS) {
+		if (stage == GENERATE_EVASIONS) {
+			evasions = get_evasions(position, white_turn, check);
+			score_evasions();
+		}
+		for (unsigned int i = next_evasion; i < evasions.size(); i++) {
+			moves.push_back(evasions[i]);
+		}
+		stage = NO_MOVES_LEFT;
+		return;
+	}
+	if (stage == HASH_MOVE && hash_move != 0 && is_pseudo_legal(position, white_turn, hash_move)
+			&& is_legal(position, check, hash_move)) {
+		Move move;
+		move.m = hash_move;
+		move.sort_score = INT_MAX;
+		moves.push_back(move);
+	}
+	if (stage <= GENERATE_CAPTURES) {
+		captures = get_captures(position, white_turn);
+	}
+	for (unsigned int i = next_capture; i < captures.size(); i++) {
+		if (captures[i].m == hash_move || !is_legal(position, check, captures[i].m)) {
+			continue;
+		}
+		Move capture = captures[i];
+		if (capture.sort_score < WINNING_CAPTURE_SCORE) {
+			// losing captures after the quiet moves
+			capture.sort_score -= 2 * WINNING_CAPTURE_SCORE;
+		}
+		moves.push_back(capture);
+	}
+	if (stage <= KILLER_MOVES) {
+		for (unsigned int index = killer_index; index < 2; index++) {
+			if (is_valid_killer(index)) {
+				Move move;
+				move.m = killers[index].m;
+				move.sort_score = KILLER_SCORES[index];
+				moves.push_back(move);
+			}
+		}
+	}
+	if (stage <= GENERATE_QUIET_MOVES) {
+		quiet_moves = get_quiet_moves(position, white_turn);
+		score_quiet_moves();
+	}
+	for (unsigned int i = next_quiet_move; i < quiet_moves.size(); i++) {
+		if (!is_picked_before(quiet_moves[i].m) && is_legal(position, check, quiet_moves[i].m)) {
+			moves.push_back(quiet_moves[i]);
+		}
+	}
+	stage = NO_MOVES_LEFT;
+}
+
+} /* namespace gunborg */
@@ -0,0 +1,93 @@
+/*
+ * Gunborg - UCI chess engine
+ * Copyright (C) 2013-2015 Torbjörn Nilsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * MovePicker.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Torbjörn Nilsson
+ */
+
+#ifndef MOVEPICKER_H_
+#define MOVEPICKER_H_
+
+#include "board.h"
+#include "moves.h"
+
+namespace gunborg {
+
+/*
+ * the stages of a MovePicker, in the order the moves are returned
+ */
+enum MovePickerStage {
+	HASH_MOVE, GENERATE_CAPTURES, WINNING_CAPTURES, KILLER_MOVES, GENERATE_QUIET_MOVES, QUIET_MOVES, LOSING_CAPTURES,
+	GENERATE_EVASIONS, EVASIONS, NO_MOVES_LEFT
+};
+
+/*
+ * Returns the legal moves of a node in alpha_beta one at a time: the hash move, winning and equal captures,
+ * the killer moves, the quiet checks, the quiet moves by history and last the losing captures. The moves of a stage are generated
+ * when the stage is reached, so a cut-off by the hash move or a capture never generates the quiet moves.
+ *
+ * In check all evasions are generated at once and returned in the same order.
+ */
+class MovePicker {
+
+private:
+	const Position& position;
+	const bool white_turn;
+	const CheckInfo& check;
+	const uint32_t hash_move;
+	const Move* killers;
+	const uint64_t (&history)[64][64];
+
+	int stage = HASH_MOVE;
+	unsigned int killer_index = 0;
+	MoveList captures;
+	unsigned int next_capture = 0;
+	MoveList quiet_moves;
+	unsigned int next_quiet_move = 0;
+	MoveList evasions;
+	unsigned int next_evasion = 0;
+
+	bool is_picked_before(uint32_t move) const;
+	bool is_valid_killer(unsigned int index) const;
+	// scores the evasions so they are picked in the order of the stages
+	void score_evasions();
+	// the history score, and the checks first
+	void score_quiet_moves();
+
+public:
+	/*
+	 * check is the check info of the position, killers are the two killer moves of the ply, hash_move is 0 if
+	 * there is none
+	 */
+	MovePicker(const Position& position, const bool white_turn, const CheckInfo& check, uint32_t hash_move,
+			const Move (&killers)[2], const uint64_t (&history)[64][64]);
+
+	/*
+	 * sets move to the next move, false if there are no moves left
+	 */
+	bool next_move(Move& move);
+
+	/*
+	 * adds the moves that have not been returned to moves, scored so pick_next_move keeps the order of the stages
+	 */
+	void remaining_moves(MoveList& moves);
+};
+
+} /* namespace gunborg */
+#endif /* MOVEPICKER_H_ */
@@ -26,7 +26,9 @@
 #include "board.h"
 #include "Cache.h"
 #include "eval.h"
+#include "MovePicker.h"
 #include "moves.h"
+#include "numa.h"
 #include "util.h"
 #include <algorithm>
 #include <atomic>
@@ -42,14 +44,56 @@ namespace gunborg {
 const int MAX_CHECK_EXTENSION = 2;
 
 Search::Search() {
+	reset();
+}
+
+void Search::reset() {
 	max_think_time_ms = 10000;
+	max_depth = 30;
 	node_count = 0;
+	tt_probes = 0;
+	tt_hits = 0;
+	qnode_count = 0;
 	save_time = true;
+	pondering = false;
+	ponderhit_received = false;
+	search_moves.clear();
+	cluster = NULL;
+	speculative = false;
+	quiet = false;
+	warm_start_moves.clear();
+	searched_root_moves.clear();
 }
 
 inline bool Search::time_to_stop() {
 	int time_elapsed = std::chrono::duration_cast < std::chrono::milliseconds > (clock.now() - start).count();
-	return (time_elapsed > max_think_time_ms  && !pondering) || !should_run;
+	if (pondering && ponderhit_received) {
+		// the time pondered is not counted
+		max_think_time_ms += time_elapsed;
+		pondering = false;
+	}
+	bool stop = (time_elapsed > max_think_time_ms  && !pondering) || !should_run;
+	if (split_points != NULL) {
+		// the main search decides when all threads should stop
+		if (stop) {
+			split_points->stop = true;
+		} else {
+			stop = split_points->stop;
+		}
+	}
+	return stop || (split_point != NULL && is_cut_off());
+}
+
+/*
+ * true if another thread has found a beta cut-off at a split point above this thread
+ */
+bool Search::is_cut_off() {
+	for (SplitPoint* sp = split_point; sp != NULL; sp = sp->parent) {
+		if (sp->cutoff) {
+			return true;
+		}
+	}
+	return false;
 }
 
 bool is_equal(const Position& p1, const Position& p2) {
@@ -106,7 +150,7 @@ void pick_next_move(MoveList& moves, const int no_sorted_moves) {
 	int max_index = no_sorted_moves;
 	int i = no_sorted_moves;
 	for (auto it = moves.begin() + no_sorted_moves; it != moves.end(); ++it) {
-		if (it->sort_score >= max_sort_score) {
+		if (it->sort_score > max_sort_score) {
 			max_index = i;
 			max_sort_score = it->sort_score;
 		}
@@ -115,13 +159,23 @@ void pick_next_move(MoveList& moves, const int no_sorted_moves) {
 	std::swap(moves[no_sorted_moves], moves[max_index]);
 }
 
-int Search::capture_quiescence_eval_search(bool white_turn, int alpha, int beta, Position& position) {
+/*
+ * searches the captures until the position is quiet. With quiet_checks the quiet moves that give check are searched
+ * as well, and in_check is true if the side to move is in check, then it may not stand pat
+ */
+int Search::capture_quiescence_eval_search(bool white_turn, int alpha, int beta, Position& position, bool quiet_checks,
+		bool in_check) {
 	if (position.p[WHITE][KING] == 0) {
 		return white_turn ? -10000 : 10000;
 	} else if (position.p[BLACK][KING] == 0) {
 		return white_turn ? 10000 : -10000;
 	}
+	if (in_check) {
+		return evasion_quiescence_search(white_turn, alpha, beta, position);
+	}
 	int static_eval = nega_evaluate(position, white_turn);
+	// a quiet check wins no material by itself, it is not searched when the position is far below alpha
+	quiet_checks = quiet_checks && static_eval + QUIET_CHECK_MARGIN >= alpha;
 	if (static_eval > alpha) {
 		alpha = static_eval;
 	}
@@ -130,10 +184,11 @@ int Search::capture_quiescence_eval_search(bool white_turn, int alpha, int beta,
 	}
 
 	MoveList capture_moves = get_captures(position, white_turn);
-	if (capture_moves.empty()) {
+	if (capture_moves.empty() && !quiet_checks) {
 		// the end point of the quiescence search
 		return static_eval;
 	}
+	CheckInfo check = check_info(position, white_turn);
 	for (unsigned int i = 0; i < capture_moves.size(); ++i) {
 		pick_next_move(capture_moves, i);
 		Move move = capture_moves[i];
@@ -141,17 +196,73 @@ int Search::capture_quiescence_eval_search(bool white_turn, int alpha, int beta,
 				&& promotion_piece(move.m) == EMPTY) {
 			continue;
 		}
-		bool legal_move = make_move(position, move);
-		if (!legal_move) {
-			unmake_move(position, move);
-			continue;
-		}
 		if (move.sort_score < 1000000) {
 			// losing move
-			unmake_move(position, move);
 			continue;
 		}
-		int res = -capture_quiescence_eval_search(!white_turn, -beta, -alpha, position);
+		if (!is_legal(position, check, move.m)) {
+			continue;
+		}
+		bool check_move = gives_check(position, check, move.m);
+		count(qnode_count);
+		make_move(position, move);
+		int res = -capture_quiescence_eval_search(!white_turn, -beta, -alpha, position, false, check_move);
+		unmake_move(position, move);
+		if (res >= beta) {
+			return beta;
+		}
+		if (res > alpha) {
+			alpha = res;
+		}
+		if (time_to_stop()) {
+			return alpha;
+		}
+	}
+	if (quiet_checks) {
+		MoveList checks = get_quiet_checks(position, white_turn, check);
+		for (auto& move : checks) {
+			if (!is_legal(position, check, move.m)) {
+				continue;
+			}
+			if (see(position, move) < 0) {
+				// the checking piece is lost
+				continue;
+			}
+			count(qnode_count);
+			make_move(position, move);
+			int res = -capture_quiescence_eval_search(!white_turn, -beta, -alpha, position, false, true);
+			unmake_move(position, move);
+			if (res >= beta) {
+				return beta;
+			}
+			if (res > alpha) {
+				alpha = res;
+			}
+			if (time_to_stop()) {
+				return alpha;
+			}
+		}
+	}
+	return alpha;
+}
+
+/*
+ * the quiescence search of a side in check, every evasion is searched and no evasion is a mate
+ */
+int Search::evasion_quiescence_search(bool white_turn, int alpha, int beta, Position& position) {
+	CheckInfo check = check_info(position, white_turn);
+	MoveList evasions = get_evasions(position, white_turn, check);
+	if (evasions.empty()) {
+		return -10000;
+	}
+	for (unsigned int i = 0; i < evasions.size(); ++i) {
+		pick_next_move(evasions, i);
+		Move move = evasions[i];
+		// only captures may check back, so a sequence of checks ends
+		bool check_move = is_capture(move.m) && gives_check(position, check, move.m);
+		count(qnode_count);
+		make_move(position, move);
+		int res = -capture_quiescence_eval_search(!white_turn, -beta, -alpha, position, false, check_move);
 		unmake_move(position, move);
 		if (res >= beta) {
 			return beta;
@@ -203,17 +314,20 @@ inline bool should_prune(int depth, bool white_turn, Position& position, int alp
 int Search::alpha_beta(bool white_turn, int depth, int alpha, int beta, Position& position, Transposition *tt,
 		bool null_move_disabled, Move (&killers)[32][2], uint64_t (&history)[64][64], int ply, int extension) {
 	if (depth == 0) {
-		return capture_quiescence_eval_search(white_turn, alpha, beta, position);
+		return capture_quiescence_eval_search(white_turn, alpha, beta, position, true, is_in_check(position, white_turn));
 	}
 	if (time_to_stop()) {
 		return alpha;
 	}
-	if (should_prune(depth, white_turn, position, alpha, beta)) {
-		return capture_quiescence_eval_search(white_turn, alpha, beta, position);
+	CheckInfo check = check_info(position, white_turn);
+
+	// a side in check can not stand pat, it is searched with all evasions
+	if (!check.checkers && should_prune(depth, white_turn, position, alpha, beta)) {
+		return capture_quiescence_eval_search(white_turn, alpha, beta, position, false, false);
 	}
 
 	// null move heuristic
-	if (!null_move_disabled && depth > 3) {
+	if (!null_move_disabled && depth > 3 && !check.checkers) {
 		// skip a turn and see if and see if we get a cut-off at shallower depth
 		// it assumes:
 		// 1. That the disadvantage of forfeiting one's turn is greater than the disadvantage of performing a shallower search.
@@ -228,116 +342,80 @@ int Search::alpha_beta(bool white_turn, int depth, int alpha, int beta, Position
 	}
 
 	// check for hit in transposition table
-	Transposition* tt_pv = probe_tt(tt, position.hash_key, generation);
-	bool cache_hit = tt_pv->hash == hash_verification(position.hash_key)
-							&& color(tt_pv->next_move) == (white_turn ? WHITE : BLACK);
-
+	TTData tt_pv;
+	bool cache_hit = probe_tt(tt, position.hash_key, tt_pv);
+	count(tt_probes);
 	if (cache_hit) {
-		if (tt_pv->depth >= depth && tt_pv->type == TT_TYPE_EXACT) {
-			return tt_pv->score;
-		} else if (tt_pv->depth == depth && tt_pv->type == TT_TYPE_LOWER_BOUND && tt_pv->score > alpha) {
-			alpha = tt_pv->score;
+		count(tt_hits);
+		if (tt_pv.depth >= depth && tt_pv.type == TT_TYPE_EXACT) {
+			return tt_pv.score;
+		} else if (tt_pv.depth == depth && tt_pv.type == TT_TYPE_LOWER_BOUND && tt_pv.score > alpha) {
+			alpha = tt_pv.score;
 			if (alpha >= beta) {
 				return beta;
 			}
-		} else if (tt_pv->depth == depth && tt_pv->type == TT_TYPE_UPPER_BOUND && tt_pv->score < beta) {
-			beta = tt_pv->score;
+		} else if (tt_pv.depth == depth && tt_pv.type == TT_TYPE_UPPER_BOUND && tt_pv.score < beta) {
+			beta = tt_pv.score;
 			if (alpha >= beta) {
 				return beta;
 			}
 		}
 	}
 
-	MoveList moves = get_moves(position, white_turn);
-	for (auto it = moves.begin(); it != moves.end(); ++it) {
-		// sort pv moves first
-		if (cache_hit && tt_pv->next_move == it->m) {
-			it->sort_score += 1100000;
-		}
-		// ...then captures in MVVLVA order
-		if (!is_capture(it->m)) {
-			// killer moves are quite moves that has previously led to a cut-off
-			if (killers[ply - 1][0].m == it->m) {
-				it->sort_score += 999999;
-			} else if (killers[ply - 1][1].m == it->m) {
-				it->sort_score += 899999;
-			} else {
-				// "history heuristics"
-				// the rest of the quite moves are sorted based on how often they increase score in the search tree
-				it->sort_score += history[from_square(it->m)][to_square(it->m)];
-			}
-		}
-	}
-
-	Transposition t;
-	t.hash = hash_verification(position.hash_key);
+	// the hash move first, then captures in MVVLVA order, killer moves and quiet moves by history
+	MovePicker picker(position, white_turn, check, cache_hit ? tt_pv.next_move : 0, killers[ply - 1], history);
+	TTData t;
 	t.depth = depth;
 	t.generation = generation;
 	int next_move = 0;
 	bool has_legal_move = false;
 	int static_eval = 0;
-	for (unsigned int i = 0; i < moves.size(); ++i) {
+	Move move;
+	for (unsigned int i = 0;; ++i) {
 
-		pick_next_move(moves, i);
-		Move move = moves[i];
-		node_count++;
-		bool legal_move = make_move(position, move);
-		if (!legal_move) {
-			unmake_move(position, move);
-			continue;
+		if (has_legal_move && split_points != NULL && depth >= MIN_SPLIT_DEPTH && split_points->idle_helpers > 0) {
+			// young brothers wait. the first move is searched, let idle helpers search the remaining moves
+			MoveList moves;
+			picker.remaining_moves(moves);
+			alpha = split(white_turn, depth, alpha, beta, position, tt, null_move_disabled, killers, history, ply,
+					extension, moves, i, next_move);
+			if (time_to_stop()) {
+				return alpha;
+			}
+			if (alpha >= beta) {
+				t.next_move = next_move;
+				t.type = TT_TYPE_LOWER_BOUND;
+				t.score = beta;
+				store_tt(tt, position.hash_key, t);
+				return beta;
+			}
+			break;
 		}
+
+		if (!picker.next_move(move)) {
+			break;
+		}
+		count(node_count);
+		bool check_move = gives_check(position, check, move.m);
+		make_move(position, move);
 		has_legal_move = true;
 
-		int res;
-		if (i < 5 && next_move == 0) {
-			int depth_extention = 0;
-			if (extension < MAX_CHECK_EXTENSION) {
-				// if this is a checking move, extend the search one ply
-				if (get_attacked_squares(position, white_turn) & position.p[white_turn ? BLACK : WHITE][KING]) {
-					extension++;
-					depth_extention = 1;
-				}
-			}
-			res = -alpha_beta(!white_turn, depth - 1 + depth_extention, -beta, -alpha, position, tt, null_move_disabled,
-				killers, history, ply + 1, extension);
-		} else {
-			// prune late moves that we do not expect to improve alpha
-			if (i == 12 && depth <= 2) {
-				static_eval = nega_evaluate(position, white_turn);
-			}
-			if (i >= 12 && depth <= 2 && static_eval + 100 < alpha) {
-				unmake_move(position, move);
-				break;
-			}
-			int depth_reduction = 0;
-			// late move reduction.
-			// we assume sort order is good enough to not search later moves as deep as the first
-			if (depth > 2 && i > 5 && !is_capture(move.m)) {
-				depth_reduction = depth > 5 && i > 20 ? 2 : 1;
-			}
-			if (beta - alpha > 1 && next_move != 0) {
-				// we do not expect to find a better move
-				// use a fast null window search to verify it!
-				res = -null_window_search(!white_turn, depth - 1 - depth_reduction, -alpha, position, tt, null_move_disabled,
-							killers, history, ply + 1, extension);
-				if (res > alpha) {
-					// score improved unexpected, we have to do a full window search
-					res = -alpha_beta(!white_turn, depth - 1 - depth_reduction, -beta, -alpha, position, tt, null_move_disabled,
-							killers, history, ply + 1, extension);
-				}
-			} else {
-				res = -alpha_beta(!white_turn, depth - 1 - depth_reduction, -beta, -alpha, position, tt, null_move_disabled,
-							killers, history, ply + 1, extension);
-			}
-			if (depth_reduction > 0 && res > alpha) {
-				// score improved "unexpected" at reduced depth
-				// re-search at normal depth
-				res = -alpha_beta(!white_turn, depth - 1, -beta, -alpha, position, tt, null_move_disabled, killers, history,
-						ply + 1, extension);
-			}
+		// prune late moves that we do not expect to improve alpha
+		if (i == 12 && depth <= 2) {
+			static_eval = nega_evaluate(position, white_turn);
 		}
+		if (i >= 12 && depth <= 2 && static_eval + 100 < alpha) {
+			unmake_move(position, move);
+			break;
+		}
+		int res = search_move(white_turn, depth, alpha, beta, position, tt, null_move_disabled, killers, history, ply,
+				extension, move, i, next_move != 0, check_move);
 
 		unmake_move(position, move);
+		if (time_to_stop()) {
+			// stopped, or a beta cut-off at a split point above, the result is not reliable
+			return alpha;
+		}
 		if (res >= beta) {
 			if (!is_capture(move.m)) {
 				if (killers[ply - 1][0].m != move.m) {
@@ -349,8 +427,7 @@ int Search::alpha_beta(bool white_turn, int depth, int alpha, int beta, Position
 			t.next_move = next_move;
 			t.type = TT_TYPE_LOWER_BOUND;
 			t.score = beta;
-			Transposition* tt_hit = probe_tt(tt, position.hash_key, generation);
-			*tt_hit = t;
+			store_tt(tt, position.hash_key, t);
 			return beta;
 		}
 
@@ -364,8 +441,7 @@ int Search::alpha_beta(bool white_turn, int depth, int alpha, int beta, Position
 		}
 	}
 	if (!has_legal_move) {
-		bool in_check = get_attacked_squares(position, !white_turn) & position.p[white_turn ? WHITE : BLACK][KING];
-		if (in_check) {
+		if (check.checkers) {
 			return -10000;
 		} else {
 			return 0; // stalemate
@@ -375,19 +451,261 @@ int Search::alpha_beta(bool white_turn, int depth, int alpha, int beta, Position
 		t.next_move = next_move;
 		t.type = TT_TYPE_EXACT;
 		t.score = alpha;
-		Transposition* tt_hit = probe_tt(tt, position.hash_key, generation);
-		*tt_hit = t;
+		store_tt(tt, position.hash_key, t);
 	} else {
 		t.type = TT_TYPE_UPPER_BOUND;
 		t.score = alpha;
-		Transposition* tt_hit = probe_tt(tt, position.hash_key, generation);
-		*tt_hit = t;
+		store_tt(tt, position.hash_key, t);
 	}
 	return alpha;
 }
 
+/*
+ * searches a move, that has been made, at a node in alpha_beta. check_move is true if the move gives check.
+ * extension is the check extensions of the node, each move gets its own copy
+ *
+ * the first moves are searched with a full window. checking moves are extended and never reduced.
+ * later moves are searched at reduced depth and/or with a null window, and re-searched if they unexpectedly improves alpha
+ */
+int Search::search_move(bool white_turn, int depth, int alpha, int beta, Position& position, Transposition *tt,
+		bool null_move_disabled, Move (&killers)[32][2], uint64_t (&history)[64][64], int ply, int extension,
+		const Move& move, unsigned int move_index, bool pv_found, bool check_move) {
+	int res;
+	int depth_extention = 0;
+	if (check_move && extension < MAX_CHECK_EXTENSION) {
+		// this is a checking move, extend the search one ply
+		extension++;
+		depth_extention = 1;
+	}
+	if (move_index < 5 && !pv_found) {
+		res = -alpha_beta(!white_turn, depth - 1 + depth_extention, -beta, -alpha, position, tt, null_move_disabled,
+			killers, history, ply + 1, extension);
+	} else {
+		// a checking move is extended instead of reduced
+		int depth_reduction = -depth_extention;
+		// late move reduction.
+		// we assume sort order is good enough to not search later moves as deep as the first
+		if (depth > 2 && move_index > 5 && !is_capture(move.m) && !check_move) {
+			depth_reduction = depth > 5 && move_index > 20 ? 2 : 1;
+		}
+		if (beta - alpha > 1 && pv_found) {
+			// we do not expect to find a better move
+			// use a fast null window search to verify it!
+			res = -null_window_search(!white_turn, depth - 1 - depth_reduction, -alpha, position, tt, null_move_disabled,
+						killers, history, ply + 1, extension);
+			if (res > alpha) {
+				// score improved unexpected, we have to do a full window search
+				res = -alpha_beta(!white_turn, depth - 1 - depth_reduction, -beta, -alpha, position, tt, null_move_disabled,
+						killers, history, ply + 1, extension);
+			}
+		} else {
+			res = -alpha_beta(!white_turn, depth - 1 - depth_reduction, -beta, -alpha, position, tt, null_move_disabled,
+						killers, history, ply + 1, extension);
+		}
+		if (depth_reduction > 0 && res > alpha) {
+			// score improved "unexpected" at reduced depth
+			// re-search at normal depth
+			res = -alpha_beta(!white_turn, depth - 1, -beta, -alpha, position, tt, null_move_disabled, killers, history,
+					ply + 1, extension);
+		}
+	}
+	return res;
+}
+
+/*
+ * Young brothers wait split point.
+ *
+ * Shares the moves with idle helpers, first_index is the number of moves of the node searched before the split.
+ * The calling thread searches moves as well and then helps its helpers until every move is searched.
+ *
+ * returns the new alpha, or beta on a cut-off, and sets next_move to the best move
+ */
+int Search::split(bool white_turn, int depth, int alpha, int beta, Position& position, Transposition *tt,
+		bool null_move_disabled, Move (&killers)[32][2], uint64_t (&history)[64][64], int ply, int extension,
+		MoveList& moves, unsigned int first_index, int& next_move) {
+	SplitPoint sp;
+	sp.parent = split_point;
+	sp.position = position;
+	sp.tt = tt;
+	sp.white_turn = white_turn;
+	sp.depth = depth;
+	sp.beta = beta;
+	sp.ply = ply;
+	sp.extension = extension;
+	sp.null_move_disabled = null_move_disabled;
+	sp.cutoff = false;
+	sp.moves = moves;
+	sp.first_index = first_index;
+	sp.alpha = alpha;
+	sp.next_move = next_move;
+
+	{
+		std::lock_guard<std::mutex> guard(split_points->lock);
+		split_points->open.push_back(&sp);
+	}
+	split_points->work_available.notify_all();
+
+	split_point = &sp;
+	search_split_point(sp, position, killers, history);
+
+	{
+		// no more helpers may join
+		std::lock_guard<std::mutex> guard(split_points->lock);
+		split_points->open.erase(std::find(split_points->open.begin(), split_points->open.end(), &sp));
+	}
+	while (true) {
+		{
+			std::lock_guard<std::mutex> guard(sp.lock);
+			if (sp.workers == 0) {
+				break;
+			}
+		}
+		// help the helpers with split points below this one while waiting for them
+		SplitPoint* child = join_split_point(&sp);
+		if (child != NULL) {
+			Position child_position = child->position;
+			search_split_point(*child, child_position, killers, history);
+			leave_split_point(child);
+			split_point = &sp;
+		} else {
+			time_to_stop();
+			// the workers are checked with the lock held, so a worker leaving before the wait is not missed
+			std::unique_lock<std::mutex> lock(split_points->lock);
+			bool workers_left;
+			{
+				std::lock_guard<std::mutex> guard(sp.lock);
+				workers_left = sp.workers > 0;
+			}
+			if (workers_left) {
+				// woken when a worker leaves a split point or a split point is opened, the timeout is for stop
+				split_points->work_available.wait_for(lock, std::chrono::milliseconds(1));
+			}
+		}
+	}
+	split_point = sp.parent;
+	next_move = sp.next_move;
+	return sp.alpha;
+}
+
+/*
+ * searches moves from the split point until there are no moves left or there is a cut-off
+ */
+void Search::search_split_point(SplitPoint& sp, Position& position, Move (&killers)[32][2], uint64_t (&history)[64][64]) {
+	CheckInfo check = check_info(position, sp.white_turn);
+	while (true) {
+		sp.lock.lock();
+		if (sp.cutoff || sp.next_index >= sp.moves.size()) {
+			sp.lock.unlock();
+			return;
+		}
+		unsigned int i = sp.next_index++;
+		pick_next_move(sp.moves, i);
+		Move move = sp.moves[i];
+		int alpha = sp.alpha;
+		bool pv_found = sp.next_move != 0;
+		sp.lock.unlock();
+
+		count(node_count);
+		bool check_move = gives_check(position, check, move.m);
+		make_move(position, move);
+		int res = search_move(sp.white_turn, sp.depth, alpha, sp.beta, position, sp.tt, sp.null_move_disabled,
+				killers, history, sp.ply, sp.extension, move, sp.first_index + i, pv_found, check_move);
+		unmake_move(position, move);
+		if (time_to_stop()) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> guard(sp.lock);
+		if (res >= sp.beta) {
+			if (!is_capture(move.m)) {
+				if (killers[sp.ply - 1][0].m != move.m) {
+					killers[sp.ply - 1][1] = killers[sp.ply - 1][0];
+					killers[sp.ply - 1][0] = move;
+				}
+			}
+			sp.alpha = sp.beta;
+			sp.next_move = move.m;
+			sp.cutoff = true;
+			return;
+		}
+		if (res > sp.alpha) {
+			sp.alpha = res;
+			sp.next_move = move.m;
+			if (!is_capture(move.m)) {
+				history[from_square(move.m)][to_square(move.m)] += sp.depth;
+			}
+		}
+	}
+}
+
+/*
+ * finds an open split point with moves left, below ancestor if not NULL, and joins it as a worker
+ */
+SplitPoint* Search::join_split_point(SplitPoint* ancestor) {
+	std::lock_guard<std::mutex> guard(split_points->lock);
+	for (auto sp : split_points->open) {
+		bool below_ancestor = ancestor == NULL;
+		for (SplitPoint* parent = sp->parent; parent != NULL && !below_ancestor; parent = parent->parent) {
+			below_ancestor = parent == ancestor;
+		}
+		if (!below_ancestor) {
+			continue;
+		}
+		std::lock_guard<std::mutex> sp_guard(sp->lock);
+		if (!sp->cutoff && sp->next_index < sp->moves.size()) {
+			sp->workers++;
+			split_point = sp;
+			return sp;
+		}
+	}
+	return NULL;
+}
+
+void Search::leave_split_point(SplitPoint* sp) {
+	{
+		// the master may return as soon as the number of workers is zero, do not touch sp afterwards
+		std::lock_guard<std::mutex> guard(split_points->lock);
+		std::lock_guard<std::mutex> sp_guard(sp->lock);
+		sp->workers--;
+	}
+	split_points->work_available.notify_all();
+}
+
+/*
+ * young brothers wait helper. waits for split points with moves left and searches them
+ */
+void Search::split_point_helper_loop(int helper_id) {
+	pin_thread(helper_id);
+	start = clock.now();
+	Move killers[32][2] = {};
+	uint64_t quites_history[64][64] = {};
+	while (should_run && !split_points->stop) {
+		SplitPoint* sp = join_split_point(NULL);
+		if (sp == NULL) {
+			std::unique_lock<std::mutex> lock(split_points->lock);
+			split_points->work_available.wait_for(lock, std::chrono::milliseconds(1));
+			continue;
+		}
+		split_points->idle_helpers--;
+		Position position = sp->position;
+		search_split_point(*sp, position, killers, quites_history);
+		split_point = NULL;
+		leave_split_point(sp);
+		split_points->idle_helpers++;
+	}
+}
+
 void Search::print_uci_info(int pv[], int depth, int score, Transposition *tt) {
+	if (quiet) {
+		return;
+	}
 	std::string pvstring = pvstring_from_stack(pv, depth);
+	ClusterResult worker_result;
+	if (cluster != NULL && cluster->best_result(depth, worker_result) && worker_result.score > score) {
+		// a worker has found a better move at this depth
+		score = worker_result.score;
+		pvstring = worker_result.pv;
+	}
 
 	int time_elapsed_last_depth_ms = std::chrono::duration_cast < std::chrono::milliseconds
 			> (clock.now() - start).count();
@@ -399,20 +717,58 @@ void Search::print_uci_info(int pv[], int depth, int score, Transposition *tt) {
 		mate_str += std::string(" mate -") + std::to_string((depth + 1)/2);
 	}
 
+	uint64_t nodes = total_node_count();
+	uint64_t nps = time_elapsed_last_depth_ms > 0 ? nodes * 1000 / time_elapsed_last_depth_ms : 0;
+
 	// uci info with score from engine's perspective
 	std::cout << "info score cp " << score << mate_str << " depth " << depth << " time " << time_elapsed_last_depth_ms << " nodes "
-			<< node_count << " hashfull " << hashfull(tt) <<" pv " << pvstring << "\n" << std::flush;
+			<< nodes << " nps " << nps << " hashfull " << hashfull(tt) <<" pv " << pvstring << "\n" << std::flush;
+}
+
+uint64_t Search::total_node_count() {
+	uint64_t nodes = node_count.load(std::memory_order_relaxed);
+	if (cluster != NULL) {
+		nodes += cluster->node_count();
+	}
+	for (auto helper : helpers) {
+		nodes += helper->node_count.load(std::memory_order_relaxed);
+	}
+	return nodes;
+}
+
+uint64_t Search::total_qnode_count() {
+	uint64_t nodes = qnode_count.load(std::memory_order_relaxed);
+	for (auto helper : helpers) {
+		nodes += helper->qnode_count.load(std::memory_order_relaxed);
+	}
+	return nodes;
+}
+
+uint64_t Search::total_tt_probes() {
+	uint64_t probes = tt_probes.load(std::memory_order_relaxed);
+	for (auto helper : helpers) {
+		probes += helper->tt_probes.load(std::memory_order_relaxed);
+	}
+	return probes;
+}
+
+uint64_t Search::total_tt_hits() {
+	uint64_t hits = tt_hits.load(std::memory_order_relaxed);
+	for (auto helper : helpers) {
+		hits += helper->tt_hits.load(std::memory_order_relaxed);
+	}
+	return hits;
 }
 
 void Search::init_sort_score(const bool white_turn, MoveList& root_moves, Position& p, Transposition *tt) {
 	// check for hit in transposition table
-	Transposition* tt_pv = probe_tt(tt, p.hash_key, generation);
-	bool cache_hit = tt_pv->next_move != 0 && tt_pv->hash == hash_verification(p.hash_key);
+	TTData tt_pv;
+	bool cache_hit = probe_tt(tt, p.hash_key, tt_pv) && tt_pv.next_move != 0;
 
 	for (auto it = root_moves.begin(); it != root_moves.end(); ++it) {
 		make_move(p, *it);
 		it->sort_score = nega_evaluate(p, white_turn);
-		if (cache_hit && it->m == tt_pv->next_move) {
+		if (cache_hit && it->m == tt_pv.next_move) {
 			it->sort_score += 1000;
 		}
 		unmake_move(p, *it);
@@ -431,21 +787,16 @@ bool Search::is_draw_by_repetition(const list& history, const Position& pos, con
 }
 
 bool Search::is_stale_mate(const bool white_turn, Position& pos) {
-	bool opponent_in_check = get_attacked_squares(pos, white_turn)
-			& (white_turn ? pos.p[BLACK][KING] : pos.p[WHITE][KING]);
-	if (opponent_in_check) {
-		return false;
-	}
-	MoveList oppenent_moves = get_moves(pos, !white_turn);
-	for (auto it = oppenent_moves.begin(); it != oppenent_moves.end(); ++it) {
-		bool legal_move = make_move(pos, *it);
-		if (legal_move) {
-			unmake_move(pos, *it);
-			return false;
-		}
-		unmake_move(pos, *it);
-	}
-	return true;
+	return get_legal_moves(pos, !white_turn).empty() && !is_in_check(pos, !white_turn);
+}
+
+bool Search::is_null_move_disabled(const bool white_turn, Position& pos) {
+	bool in_check = is_in_check(pos, white_turn);
+	bool is_late_end_game = pop_count(pos.p[WHITE][QUEEN] | pos.p[BLACK][QUEEN]
+						  | pos.p[WHITE][BISHOP]| pos.p[BLACK][BISHOP]
+					      | pos.p[WHITE][KNIGHT]| pos.p[BLACK][KNIGHT]
+					      | pos.p[WHITE][ROOK]  | pos.p[BLACK][ROOK]) <= 2;
+	return in_check || is_late_end_game;
 }
 
 /*
@@ -481,32 +832,51 @@ void Search::ponder() {
 }
 
 void Search::ponder_hit() {
-	int time_elapsed = std::chrono::duration_cast < std::chrono::milliseconds > (clock.now() - start).count();
-	max_think_time_ms += time_elapsed;
-	pondering = false;
+	ponderhit_received = true;
 }
 
 void Search::search_best_move(const Position& position, const bool white_turn, const list history, Transposition * tt) {
 	start = clock.now();
+	if (!speculative) {
+		pin_thread(0);
+	}
 	std::string best_move;
 	std::string ponder_move = "";
 
 	Position pos = position;
-	MoveList root_moves = get_moves(pos, white_turn);
+	MoveList root_moves = get_legal_moves(pos, white_turn);
+	if (!search_moves.empty()) {
+		MoveList moves_to_search;
+		for (auto root_move : root_moves) {
+			if (std::find(search_moves.begin(), search_moves.end(), uci_move(root_move.m)) != search_moves.end()) {
+				moves_to_search.push_back(root_move);
+			}
+		}
+		root_moves = moves_to_search;
+	}
 
 	init_sort_score(white_turn, root_moves, pos, tt);
+	if (!warm_start_moves.empty()) {
+		// the order of a speculative search of this position
+		for (auto& root_move : root_moves) {
+			root_move.sort_score = INT_MIN / 2;
+			for (auto warm_move : warm_start_moves) {
+				if (warm_move.m == root_move.m) {
+					root_move.sort_score = warm_move.sort_score;
+				}
+			}
+		}
+	}
+	// the best score and pv of each completed depth
+	std::vector<ClusterResult> completed_depths;
 
 	int alpha = INT_MIN;
 	Move killers[32][2] = {};
 	uint64_t quites_history[64][64] = {};
 
-	uint64_t attacked_squares_by_opponent = get_attacked_squares(pos, !white_turn);
-	bool in_check = attacked_squares_by_opponent & (white_turn ? pos.p[WHITE][KING] : pos.p[BLACK][KING]);
-	bool is_late_end_game = pop_count(pos.p[WHITE][QUEEN] | pos.p[BLACK][QUEEN]
-						  | pos.p[WHITE][BISHOP]| pos.p[BLACK][BISHOP]
-					      | pos.p[WHITE][KNIGHT]| pos.p[BLACK][KNIGHT]
-					      | pos.p[WHITE][ROOK]  | pos.p[BLACK][ROOK]) <= 2;
-	bool null_move_disabled = in_check || is_late_end_game;
+	bool null_move_disabled = is_null_move_disabled(white_turn, pos);
+
+	start_helpers(pos, white_turn, tt);
 
 	for (int depth = 1; depth <= max_depth; depth++) {
 		// moves sorted for the next depth
@@ -516,12 +886,8 @@ void Search::search_best_move(const Position& position, const bool white_turn, c
 		for (unsigned int i = 0; i < root_moves.size(); i++) {
 			pick_next_move(root_moves, i);
 			Move root_move = root_moves[i];
-			node_count++;
-			bool legal_move = make_move(pos, root_move);
-			if (!legal_move) {
-				unmake_move(pos, root_move);
-				continue;
-			}
+			count(node_count);
+			make_move(pos, root_move);
 			int move_score;
 			if (is_draw_by_repetition(history, pos, white_turn) || is_stale_mate(white_turn, pos)) {
 				move_score = 0;
@@ -566,14 +932,15 @@ void Search::search_best_move(const Position& position, const bool white_turn, c
 					pv[p] = 0;
 				}
 				pv[0] = root_move.m;
-				uint32_t next_pv_move = root_move.m;
-				uint64_t hash = pos.hash_key;
+				// follow the pv in the transposition table on a copy of the position
+				Position pv_position = pos;
+				Move next_pv_move = root_move;
 				for (int p = 1; p < depth - 1; p++) {
-					hash ^= move_hash(next_pv_move);
-					Transposition* next = probe_tt(tt, hash, generation);
-					if (next->hash == hash_verification(hash) && next->next_move != 0) {
-						pv[p] = next->next_move;
-						next_pv_move = next->next_move;
+					make_move(pv_position, next_pv_move);
+					TTData next;
+					if (probe_tt(tt, pv_position.hash_key, next) && next.next_move != 0) {
+						pv[p] = next.next_move;
+						next_pv_move.m = next.next_move;
 					} else {
 						break;
 					}
@@ -595,6 +962,12 @@ void Search::search_best_move(const Position& position, const bool white_turn, c
 			break;
 		}
 		print_uci_info(pv, depth, alpha, tt);
+		ClusterResult completed;
+		completed.depth = depth;
+		completed.score = alpha;
+		completed.pv = pvstring_from_stack(pv, depth);
+		completed_depths.push_back(completed);
+		searched_root_moves = next_iteration_root_moves;
 		int time_elapsed_last_depth_ms = std::chrono::duration_cast < std::chrono::milliseconds
 						> (clock.now() - start).count();
 		if (!pondering && save_time && (4 * time_elapsed_last_depth_ms) > max_think_time_ms) {
@@ -608,10 +981,45 @@ void Search::search_best_move(const Position& position, const bool white_turn, c
 		}
 		root_moves = next_iteration_root_moves;
 	}
-	while(pondering && should_run) {
+	wait_for_helpers();
+	while(pondering && should_run && !ponderhit_received) {
 		// wait for ponderhit (or stop)
 		std::this_thread::sleep_for(std::chrono::milliseconds(3));
 	}
+	pondering = false;
+	if (cluster != NULL) {
+		// the workers end a depth limited search by themselves, otherwise they stop with this search
+		if ((int) completed_depths.size() < max_depth) {
+			should_run = false;
+		}
+		cluster->finish(should_run);
+		// the best move at the deepest depth completed by all searches
+		int depth = std::min((int) completed_depths.size(), cluster->completed_depth(max_depth));
+		ClusterResult worker_result;
+		if (depth > 0 && cluster->best_result(depth, worker_result)
+				&& worker_result.score > completed_depths[depth - 1].score) {
+			std::cout << "info score cp " << worker_result.score << " depth " << depth << " nodes "
+					<< total_node_count() << " pv " << worker_result.pv << "\n";
+			std::vector<std::string> worker_pv = ::split(worker_result.pv);
+			best_move = worker_pv[0];
+			ponder_move = worker_pv.size() > 1 ? worker_pv[1] : "";
+		} else if (depth > 0) {
+			std::vector<std::string> own_pv = ::split(completed_depths[depth - 1].pv);
+			best_move = own_pv[0];
+			ponder_move = own_pv.size() > 1 ? own_pv[1] : "";
+		}
+	}
+	if (quiet) {
+		return;
+	}
+	if (best_move.empty()) {
+		// stopped before the first move was searched, play the first legal move
+		if (!root_moves.empty()) {
+			int pv_first[1] = { (int) root_moves[0].m };
+			std::stringstream ss(pvstring_from_stack(pv_first, 1));
+			getline(ss, best_move, ' ');
+		}
+	}
 	std::cout << "bestmove " << best_move;
 	if (!ponder_move.empty()) {
 		std::cout << " ponder " << ponder_move;
@@ -620,7 +1028,179 @@ void Search::search_best_move(const Position& position, const bool white_turn, c
 	return;
 }
 
+MoveList likely_replies(Position& position, const bool white_turn, Transposition* tt, unsigned int count) {
+	MoveList replies = get_legal_moves(position, white_turn);
+	TTData tt_best;
+	bool cache_hit = probe_tt(tt, position.hash_key, tt_best) && tt_best.next_move != 0;
+	for (auto& move : replies) {
+		make_move(position, move);
+		TTData reply;
+		if (probe_tt(tt, position.hash_key, reply) && reply.type == TT_TYPE_EXACT) {
+			// the score is from the other side's perspective
+			move.sort_score = -reply.score;
+		} else {
+			move.sort_score = nega_evaluate(position, white_turn);
+		}
+		if (cache_hit && move.m == tt_best.next_move) {
+			move.sort_score += 1000;
+		}
+		unmake_move(position, move);
+	}
+	for (unsigned int i = 0; i < replies.size() && i < count; i++) {
+		pick_next_move(replies, i);
+	}
+	if (replies.size() > count) {
+		replies.resize(count);
+	}
+	return replies;
+}
+
+/*
+ * iterative deepening of a lazy smp helper thread. The helper has its own position, killers and history but
+ * shares the transposition table with the main search. The helpers with odd id search one ply ahead of the
+ * main search to make the threads diverge.
+ */
+void Search::helper_search(const Position& position, const bool white_turn, Transposition * tt, int helper_id) {
+	pin_thread(helper_id);
+	start = clock.now();
+	Position pos = position;
+	Move killers[32][2] = {};
+	uint64_t quites_history[64][64] = {};
+
+	bool null_move_disabled = is_null_move_disabled(white_turn, pos);
+
+	for (int depth = 1 + (helper_id & 1); depth <= max_depth; depth++) {
+		alpha_beta(white_turn, depth, -MAX_SCORE, MAX_SCORE, pos, tt, null_move_disabled, killers, quites_history, 1, 0);
+		if (time_to_stop()) {
+			break;
+		}
+	}
+}
+
+/*
+ * makes sure there are threads - 1 parked helper threads. The threads are only recreated when the number of
+ * threads changes
+ */
+void Search::resize_helper_pool() {
+	if (helper_threads.size() == (unsigned int) threads - 1) {
+		return;
+	}
+	stop_helper_pool();
+	for (int i = 1; i < threads; i++) {
+		Search* helper = new Search();
+		helpers.push_back(helper);
+		helper_threads.push_back(std::thread(&Search::helper_thread_loop, helper, this, i));
+	}
+}
+
+void Search::stop_helper_pool() {
+	{
+		std::lock_guard<std::mutex> guard(pool_lock);
+		exit_pool = true;
+	}
+	pool_changed.notify_all();
+	for (auto& helper_thread : helper_threads) {
+		helper_thread.join();
+	}
+	for (auto helper : helpers) {
+		delete helper;
+	}
+	helper_threads.clear();
+	helpers.clear();
+	exit_pool = false;
+}
+
+/*
+ * the life of a helper thread. Parks until the main search starts a search, helps with it until the main search
+ * stops it and parks again
+ */
+void Search::helper_thread_loop(Search* main_search, int helper_id) {
+	int last_search_id = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(main_search->pool_lock);
+			while (main_search->search_id == last_search_id && !main_search->exit_pool) {
+				main_search->pool_changed.wait(lock);
+			}
+			if (main_search->exit_pool) {
+				return;
+			}
+			last_search_id = main_search->search_id;
+		}
+		if (split_points != NULL) {
+			split_point_helper_loop(helper_id);
+		} else {
+			helper_search(main_search->helper_position, main_search->helper_white_turn, main_search->helper_tt, helper_id);
+		}
+		{
+			std::lock_guard<std::mutex> guard(main_search->pool_lock);
+			main_search->working_helpers--;
+		}
+		main_search->pool_changed.notify_all();
+	}
+}
+
+/*
+ * lazy smp: the helpers search the same position, without any coordination besides the shared transposition table.
+ * ybw: the helpers wait for split points in the tree searched by this thread.
+ */
+void Search::start_helpers(const Position& position, const bool white_turn, Transposition * tt) {
+	resize_helper_pool();
+	if (helpers.empty()) {
+		return;
+	}
+	if (smp_mode == YBW) {
+		split_points = new SplitPoints();
+		split_points->idle_helpers = threads - 1;
+		split_points->stop = false;
+	}
+	for (auto helper : helpers) {
+		helper->reset();
+		helper->should_run = true;
+		helper->max_think_time_ms = INT_MAX;
+		helper->max_depth = max_depth;
+		helper->generation = generation;
+		helper->split_points = split_points;
+	}
+	{
+		std::lock_guard<std::mutex> guard(pool_lock);
+		helper_position = position;
+		helper_white_turn = white_turn;
+		helper_tt = tt;
+		working_helpers = helpers.size();
+		search_id++;
+	}
+	pool_changed.notify_all();
+}
+
+/*
+ * stops the helpers and waits until all of them are parked
+ */
+void Search::wait_for_helpers() {
+	if (helpers.empty()) {
+		return;
+	}
+	for (auto helper : helpers) {
+		helper->should_run = false;
+	}
+	if (split_points != NULL) {
+		split_points->stop = true;
+		split_points->work_available.notify_all();
+	}
+	{
+		std::unique_lock<std::mutex> lock(pool_lock);
+		while (working_helpers > 0) {
+			pool_changed.wait(lock);
+		}
+	}
+	if (split_points != NULL) {
+		delete split_points;
+		split_points = NULL;
+	}
+}
+
 Search::~Search() {
+	stop_helper_pool();
 }
 
 } /* namespace gunborg */
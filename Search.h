@@ -26,53 +26,200 @@
 
 #include "board.h"
 #include "Cache.h"
+#include "Cluster.h"
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace gunborg {
 
+/*
+ * how the helper threads are used
+ *
+ * LAZY_SMP: the helpers search the same position and share the transposition table
+ * YBW: young brothers wait, when the first move at a node is searched the remaining moves can be searched in parallel
+ */
+enum SmpMode {
+	LAZY_SMP, YBW
+};
+
+/*
+ * A node where the remaining moves are shared between threads.
+ *
+ * Everything below the lock is shared and must only be accessed while holding it
+ */
+struct SplitPoint {
+	SplitPoint* parent = NULL;
+	Position position;
+	Transposition* tt = NULL;
+	bool white_turn = true;
+	int depth = 0;
+	int beta = 0;
+	int ply = 0;
+	int extension = 0;
+	bool null_move_disabled = false;
+	// a beta cut-off at this split point, all threads searching below it should stop
+	std::atomic_bool cutoff;
+
+	std::mutex lock;
+	unsigned int first_index = 0; // the index of the first move of moves at the node
+	MoveList moves;
+	unsigned int next_index = 0;
+	int alpha = 0;
+	int next_move = 0;
+	int workers = 0; // number of threads, besides the master, searching moves of this split point
+};
+
+/*
+ * the split points that have moves left to search, shared by all threads of a search
+ */
+struct SplitPoints {
+	std::mutex lock;
+	std::condition_variable work_available;
+	std::deque<SplitPoint*> open;
+	std::atomic_int idle_helpers;
+	std::atomic_bool stop;
+};
+
+/*
+ * increments a counter that only one thread writes, without a locked instruction
+ */
+inline void count(std::atomic<uint64_t>& counter) {
+	counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
 class Search {
 
 private:
 	std::chrono::high_resolution_clock clock;
 	std::chrono::high_resolution_clock::time_point start;
+	// only read and written by the thread of the search, the reader sets ponderhit_received instead
 	bool pondering = false;
+	std::atomic_bool ponderhit_received;
 	static const int WINDOW_SIZE = 56;
 	static const int START_WINDOW_SIZE = 30;
 	static const int DELTA_PRUNING_MARGIN = 200;
+	static const int QUIET_CHECK_MARGIN = 300;
+	static const int MAX_SCORE = 20000;
+	static const int MIN_SPLIT_DEPTH = 4;
+
+	// smp helpers, searching the same position and sharing the transposition table
+	std::vector<Search*> helpers;
+	// the threads of the helpers, kept between searches and parked on pool_changed when not searching
+	std::vector<std::thread> helper_threads;
+	std::mutex pool_lock;
+	std::condition_variable pool_changed;
+	int search_id = 0; // incremented when a search starts, wakes the helpers
+	int working_helpers = 0;
+	bool exit_pool = false;
+	// the position the helpers should search, set when a search starts
+	Position helper_position;
+	bool helper_white_turn = true;
+	Transposition* helper_tt = NULL;
+	// shared between all threads in ybw mode, owned by the main search
+	SplitPoints* split_points = NULL;
+	// the innermost split point this thread is searching below
+	SplitPoint* split_point = NULL;
 
 	int alpha_beta(bool white_turn, int depth, int alpha, int beta, Position& position, Transposition *tt,
 			bool null_move_disabled, Move (&killers)[32][2], uint64_t (&history)[64][64], int ply, int extension);
 	int null_window_search(bool white_turn, int depth, int beta, Position& position, Transposition *tt,
 			bool null_move_disabled, Move (&killers)[32][2], uint64_t (&history)[64][64], int ply, int extension);
-	int capture_quiescence_eval_search(bool white_turn, int alpha, int beta, Position& position);
+	int capture_quiescence_eval_search(bool white_turn, int alpha, int beta, Position& position, bool quiet_checks,
+			bool in_check);
+	int evasion_quiescence_search(bool white_turn, int alpha, int beta, Position& position);
+	int search_move(bool white_turn, int depth, int alpha, int beta, Position& position, Transposition *tt,
+			bool null_move_disabled, Move (&killers)[32][2], uint64_t (&history)[64][64], int ply, int extension,
+			const Move& move, unsigned int move_index, bool pv_found, bool check_move);
 	int aspiration_window_search(bool white_turn, int depth, int alpha, int beta, Position& pos, Transposition *tt,
 			bool in_check, Move (&killers)[32][2], uint64_t (&history)[64][64]);
 
 	bool time_to_stop();
+	bool is_cut_off();
 	void print_uci_info(int pv[], int depth, int score, Transposition *tt);
 	void init_sort_score(const bool white_turn, MoveList& root_moves, Position& p, Transposition *tt);
 	bool is_draw_by_repetition(
 			const list& history, const Position& pos, const bool white_turn);
 	bool is_stale_mate(const bool white_turn, Position& pos);
+	bool is_null_move_disabled(const bool white_turn, Position& pos);
+
+	void helper_search(const Position& position, const bool white_turn, Transposition * tt, int helper_id);
+
+	int split(bool white_turn, int depth, int alpha, int beta, Position& position, Transposition *tt,
+			bool null_move_disabled, Move (&killers)[32][2], uint64_t (&history)[64][64], int ply, int extension,
+			MoveList& moves, unsigned int first_index, int& next_move);
+	void search_split_point(SplitPoint& sp, Position& position, Move (&killers)[32][2], uint64_t (&history)[64][64]);
+	SplitPoint* join_split_point(SplitPoint* ancestor);
+	void leave_split_point(SplitPoint* sp);
+	void split_point_helper_loop(int helper_id);
+
+	void resize_helper_pool();
+	void stop_helper_pool();
+	void helper_thread_loop(Search* main_search, int helper_id);
+	void start_helpers(const Position& position, const bool white_turn, Transposition * tt);
+	void wait_for_helpers();
 
 public:
 	Search();
 	std::atomic_bool should_run;
 	int max_think_time_ms;
 	int max_depth = 30;
-	int node_count;
+	// written only by the thread of the search and read by the main search while it runs, see count
+	std::atomic<uint64_t> node_count;
+	// transposition table probes in alpha beta, and the probes that found an entry for the side to move
+	std::atomic<uint64_t> tt_probes;
+	std::atomic<uint64_t> tt_hits;
+	// moves made in the quiescence search, they are not counted in node_count
+	std::atomic<uint64_t> qnode_count;
+	int threads = 1;
+	SmpMode smp_mode = LAZY_SMP;
 	bool save_time;
 	uint8_t generation = 0;
+	// the root moves to search, all moves if empty (uci go searchmoves)
+	std::vector<std::string> search_moves;
+	// the workers searching the other root moves of a cluster search, NULL if not a cluster search
+	Cluster* cluster = NULL;
+	// a speculative search ponders on a reply the gui did not ask for
+	bool speculative = false;
+	// a quiet search prints no info or bestmove
+	bool quiet = false;
+	// root moves with the scores of an earlier search of the same position, used to order the root moves
+	MoveList warm_start_moves;
+	// the root moves with their scores at the last completed depth
+	MoveList searched_root_moves;
+
+	/*
+	 * resets the limits and counters before a new search, the helper threads are kept
+	 */
+	void reset();
 
 	void search_best_move(const Position& position, const bool white_turn, list history, Transposition * tt);
 
 	void ponder();
+	/*
+	 * may be called from any thread, the search leaves ponder mode and starts its clock at its next time check
+	 */
 	void ponder_hit();
 
+	/*
+	 * nodes searched by this search and all its helpers
+	 */
+	uint64_t total_node_count();
+	uint64_t total_qnode_count();
+	uint64_t total_tt_probes();
+	uint64_t total_tt_hits();
+
 	virtual ~Search();
 };
 
+/*
+ * the count most likely replies of the side to move, ranked by the transposition table and the evaluation
+ */
+MoveList likely_replies(Position& position, const bool white_turn, Transposition* tt, unsigned int count);
+
 } /* namespace gunborg */
 #endif /* SEARCH_H_ */
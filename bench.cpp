@@ -0,0 +1,319 @@
+/*
+ * Gunborg - UCI chess engine
+ * Copyright (C) 2013-2015 Torbjörn Nilsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * bench.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Torbjörn Nilsson
+ */
+
+#include "bench.h"
+#include "board.h"
+#include "fill.h"
+#include "magic.h"
+#include "moves.h"
+#include "numa.h"
+#include "uci.h"
+#include <chrono>
+#include <iostream>
+#include <limits.h>
+#include <vector>
+
+namespace {
+
+const char* BENCH_POSITIONS[] = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+	"r1bqkb1r/pp3ppp/2nppn2/8/3NP3/2N5/PPP2PPP/R1BQKB1R w KQkq - 0 6",
+	"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"
+};
+
+const int NO_BENCH_POSITIONS = sizeof(BENCH_POSITIONS) / sizeof(BENCH_POSITIONS[0]);
+
+struct BenchResult {
+	double time_ms = 0;
+	uint64_t nodes = 0;
+	uint64_t tt_probes = 0;
+	uint64_t tt_hits = 0;
+};
+
+void print_row(int threads, const std::string& position, int depth, const BenchResult& result,
+		const BenchResult& one_thread) {
+	double seconds = result.time_ms / 1000;
+	uint64_t nps = seconds > 0 ? result.nodes / seconds : 0;
+	std::cout << threads << "," << position << "," << depth << "," << result.time_ms << "," << result.nodes << ","
+			<< nps << "," << nps / threads << ","
+			<< (result.time_ms > 0 ? one_thread.time_ms / result.time_ms : 0) << ","
+			<< (one_thread.nodes > 0 ? (double) result.nodes / one_thread.nodes - 1 : 0) << ","
+			<< (result.tt_probes > 0 ? (double) result.tt_hits / result.tt_probes : 0) << "\n" << std::flush;
+}
+
+/*
+ * searches the position to depth with an empty transposition table, allocated for the current thread affinity
+ */
+BenchResult search_bench_position(gunborg::Search& search, const char* fen, int depth, int threads,
+		gunborg::SmpMode smp_mode) {
+	Transposition* tt = allocate_tt(hash_size, threads);
+	FenInfo fen_info = parse_fen(fen);
+	list history;
+	search.reset();
+	search.quiet = true;
+	search.should_run = true;
+	search.max_depth = depth;
+	search.max_think_time_ms = INT_MAX;
+	search.threads = threads;
+	search.smp_mode = smp_mode;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	search.search_best_move(fen_info.position, fen_info.white_turn, history, tt);
+	BenchResult result;
+	result.time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	result.nodes = search.total_node_count();
+	result.tt_probes = search.total_tt_probes();
+	result.tt_hits = search.total_tt_hits();
+	free_tt(tt, hash_size);
+	return result;
+}
+
+// the sliders and occupied squares of an attack map
+struct AttackMapInput {
+	uint64_t diagonal_sliders;
+	uint64_t straight_sliders;
+	uint64_t occupied_squares;
+};
+
+AttackMapInput attack_map_input(const Position& position, int side, uint64_t occupied_squares) {
+	AttackMapInput input;
+	input.diagonal_sliders = position.p[side][BISHOP] | position.p[side][QUEEN];
+	input.straight_sliders = position.p[side][ROOK] | position.p[side][QUEEN];
+	input.occupied_squares = occupied_squares;
+	return input;
+}
+
+/*
+ * the attack maps of the bench positions and the positions after their legal moves: for the check test after each
+ * legal move, and for the king test in the swap loop of see after each capture
+ */
+void collect_attack_map_inputs(std::vector<AttackMapInput>& check_inputs, std::vector<AttackMapInput>& see_inputs) {
+	for (int i = 0; i < NO_BENCH_POSITIONS; i++) {
+		FenInfo fen_info = parse_fen(BENCH_POSITIONS[i]);
+		std::vector<std::pair<Position, bool> > positions;
+		positions.push_back(std::make_pair(fen_info.position, fen_info.white_turn));
+		for (auto move : get_legal_moves(fen_info.position, fen_info.white_turn)) {
+			Position child = fen_info.position;
+			make_move(child, move);
+			positions.push_back(std::make_pair(child, !fen_info.white_turn));
+		}
+		for (auto& p : positions) {
+			Position& position = p.first;
+			int side = p.second ? WHITE : BLACK;
+			for (auto move : get_legal_moves(position, p.second)) {
+				make_move(position, move);
+				check_inputs.push_back(attack_map_input(position, side, occupancy(position)));
+				unmake_move(position, move);
+			}
+			for (auto move : get_captures(position, p.second)) {
+				see_inputs.push_back(attack_map_input(position, side,
+						occupancy(position) & ~(1ULL << from_square(move.m))));
+			}
+		}
+	}
+}
+
+#ifdef INCREMENTAL_ATTACKS
+const char* ATTACK_TABLES = "incremental";
+#else
+const char* ATTACK_TABLES = "from scratch";
+#endif
+
+/*
+ * makes and unmakes the legal moves of the bench positions and the positions after their legal moves, with the
+ * check test and the check info after each move, the attacks the search reads after a move
+ */
+void time_make_moves() {
+	const int ITERATIONS = 100;
+	std::vector<std::pair<Position, bool> > positions;
+	for (int i = 0; i < NO_BENCH_POSITIONS; i++) {
+		FenInfo fen_info = parse_fen(BENCH_POSITIONS[i]);
+		positions.push_back(std::make_pair(fen_info.position, fen_info.white_turn));
+		for (auto move : get_legal_moves(fen_info.position, fen_info.white_turn)) {
+			Position child = fen_info.position;
+			make_move(child, move);
+			positions.push_back(std::make_pair(child, !fen_info.white_turn));
+		}
+	}
+	std::vector<MoveList> moves;
+	for (auto& p : positions) {
+		moves.push_back(get_legal_moves(p.first, p.second));
+	}
+	uint64_t no_moves = 0;
+	uint64_t checksum = 0;
+	std::chrono::high_resolution_clock clock;
+	std::chrono::high_resolution_clock::time_point start = clock.now();
+	for (int i = 0; i < ITERATIONS; i++) {
+		for (unsigned int j = 0; j < positions.size(); j++) {
+			Position& position = positions[j].first;
+			bool white_turn = positions[j].second;
+			for (auto move : moves[j]) {
+				make_move(position, move);
+				checksum += is_in_check(position, white_turn) + check_info(position, !white_turn).checkers;
+				unmake_move(position, move);
+				no_moves++;
+			}
+		}
+	}
+	double time_ms = std::chrono::duration_cast<std::chrono::microseconds>(clock.now() - start).count() / 1000.0;
+	std::cout << "bench make moves, attack tables " << ATTACK_TABLES << " " << no_moves << " moves in " << time_ms
+			<< " ms (checksum " << checksum << ")\n";
+}
+
+void time_attack_maps(const std::string& name, const std::vector<AttackMapInput>& inputs) {
+	const int ITERATIONS = 1000;
+	const char* names[3] = { "magic", "sse2 fill", "avx2 fill" };
+	uint64_t (*attack_maps[3])(uint64_t, uint64_t, uint64_t) = { magic_slider_attack_map, sse2_slider_attack_map,
+			slider_attack_map };
+	// slider_attack_map is the avx2 fill if the cpu has avx2, else the same as magic
+	int no_attack_maps = std::string(slider_attack_map_backend()) == names[2] ? 3 : 2;
+	std::cout << "bench attack maps " << name << " " << inputs.size() * ITERATIONS << " maps:";
+	uint64_t first_checksum = 0;
+	std::chrono::high_resolution_clock clock;
+	for (int i = 0; i < no_attack_maps; i++) {
+		uint64_t checksum = 0;
+		std::chrono::high_resolution_clock::time_point start = clock.now();
+		for (int j = 0; j < ITERATIONS; j++) {
+			for (auto& input : inputs) {
+				checksum += attack_maps[i](input.diagonal_sliders, input.straight_sliders, input.occupied_squares);
+			}
+		}
+		double time_ms = std::chrono::duration_cast<std::chrono::microseconds>(clock.now() - start).count() / 1000.0;
+		std::cout << (i > 0 ? ", " : " ") << names[i] << " " << time_ms << " ms";
+		if (i > 0 && checksum != first_checksum) {
+			std::cout << " (differs from magic)";
+		}
+		first_checksum = i == 0 ? checksum : first_checksum;
+	}
+	std::cout << "\n";
+}
+
+}
+
+void bench_smp(int max_threads, int depth, gunborg::SmpMode smp_mode) {
+	std::vector<int> thread_counts;
+	for (int threads = 1; threads < max_threads; threads *= 2) {
+		thread_counts.push_back(threads);
+	}
+	thread_counts.push_back(max_threads);
+
+	std::vector<BenchResult> one_thread(NO_BENCH_POSITIONS);
+	BenchResult one_thread_total;
+	std::cout << "threads,position,depth,time_ms,nodes,nps,nps_per_thread,speedup,node_overhead,tt_hit_rate\n";
+	for (int threads : thread_counts) {
+		// one search for all positions, the helper threads are kept between the searches
+		gunborg::Search search;
+		BenchResult total;
+		for (int i = 0; i < NO_BENCH_POSITIONS; i++) {
+			BenchResult result = search_bench_position(search, BENCH_POSITIONS[i], depth, threads, smp_mode);
+			if (threads == 1) {
+				one_thread[i] = result;
+			}
+			print_row(threads, std::to_string(i + 1), depth, result, one_thread[i]);
+			total.time_ms += result.time_ms;
+			total.nodes += result.nodes;
+			total.tt_probes += result.tt_probes;
+			total.tt_hits += result.tt_hits;
+		}
+		if (threads == 1) {
+			one_thread_total = total;
+		}
+		print_row(threads, "all", depth, total, one_thread_total);
+	}
+}
+
+void bench_numa(int threads, int depth, gunborg::SmpMode smp_mode) {
+	const AffinityMode modes[] = { AFFINITY_NONE, AFFINITY_CORE, AFFINITY_NODE };
+	AffinityMode configured_mode = get_affinity_mode();
+	std::cout << "numa nodes " << numa_node_count() << "\n";
+	std::cout << "affinity,threads,depth,time_ms,nodes,nps,tt_hit_rate\n";
+	for (AffinityMode mode : modes) {
+		set_affinity_mode(mode);
+		gunborg::Search search;
+		BenchResult total;
+		for (int i = 0; i < NO_BENCH_POSITIONS; i++) {
+			BenchResult result = search_bench_position(search, BENCH_POSITIONS[i], depth, threads, smp_mode);
+			total.time_ms += result.time_ms;
+			total.nodes += result.nodes;
+			total.tt_probes += result.tt_probes;
+			total.tt_hits += result.tt_hits;
+		}
+		double seconds = total.time_ms / 1000;
+		std::cout << affinity_mode_name(mode) << "," << threads << "," << depth << "," << total.time_ms << ","
+				<< total.nodes << "," << (seconds > 0 ? (uint64_t) (total.nodes / seconds) : 0) << ","
+				<< (total.tt_probes > 0 ? (double) total.tt_hits / total.tt_probes : 0) << "\n" << std::flush;
+	}
+	set_affinity_mode(configured_mode);
+}
+
+void bench_attacks() {
+	// random occupied squares with about a third of the squares set, from a fixed seed
+	const int NO_OCCUPANCIES = 1024;
+	const int ITERATIONS = 1000;
+	std::vector<uint64_t> occupancies(NO_OCCUPANCIES);
+	uint64_t seed = 0x9e3779b97f4a7c15ULL;
+	for (auto& occupied_squares : occupancies) {
+		occupied_squares = ~0ULL;
+		for (int i = 0; i < 2; i++) {
+			seed ^= seed >> 12;
+			seed ^= seed << 25;
+			seed ^= seed >> 27;
+			occupied_squares &= seed * 2685821657736338717ULL;
+		}
+	}
+	uint64_t lookups = 2ULL * ITERATIONS * NO_OCCUPANCIES * 64;
+	// the magic table, and the pext table if the cpu has pext, then the table picked at startup is used again
+	bool startup_pext = std::string(attack_backend()) == "pext";
+	for (int pext = 0; pext < 2; pext++) {
+		set_pext_attacks(pext);
+		if (pext && std::string(attack_backend()) != "pext") {
+			break;
+		}
+		uint64_t checksum = 0;
+		std::chrono::high_resolution_clock clock;
+		std::chrono::high_resolution_clock::time_point start = clock.now();
+		for (int i = 0; i < ITERATIONS; i++) {
+			for (auto occupied_squares : occupancies) {
+				for (int square = 0; square < 64; square++) {
+					checksum += bishop_attacks(occupied_squares, square) ^ rook_attacks(occupied_squares, square);
+				}
+			}
+		}
+		double time_ms = std::chrono::duration_cast<std::chrono::microseconds>(clock.now() - start).count() / 1000.0;
+		std::cout << "bench attacks " << attack_backend() << " " << lookups << " lookups in " << time_ms << " ms";
+		if (time_ms > 0) {
+			std::cout << " (" << (uint64_t) (lookups / time_ms * 1000) << " lookups/s, checksum " << checksum << ")";
+		}
+		std::cout << "\n";
+	}
+	set_pext_attacks(startup_pext);
+
+	std::vector<AttackMapInput> check_inputs;
+	std::vector<AttackMapInput> see_inputs;
+	collect_attack_map_inputs(check_inputs, see_inputs);
+	time_attack_maps("check", check_inputs);
+	time_attack_maps("see", see_inputs);
+	time_make_moves();
+}
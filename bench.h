@@ -0,0 +1,66 @@
+/*
+ * Gunborg - UCI chess engine
+ * Copyright (C) 2013-2015 Torbjörn Nilsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * bench.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Torbjörn Nilsson
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include "Search.h"
+
+/*
+ * SMP scaling benchmark. Searches a fixed set of positions to depth with 1, 2, 4 ... max_threads threads, each
+ * search with an empty transposition table, and prints csv:
+ *
+ * threads,position,depth,time_ms,nodes,nps,nps_per_thread,speedup,node_overhead,tt_hit_rate
+ *
+ * speedup is the time to depth with one thread divided by the time to depth, node_overhead is the extra nodes
+ * compared to one thread. After the rows of the positions there is a row with position "all" with the totals
+ * of each thread count.
+ */
+void bench_smp(int max_threads, int depth, gunborg::SmpMode smp_mode);
+
+/*
+ * Thread affinity benchmark. Searches the positions of bench_smp to depth with the given threads once with each
+ * thread affinity (none, core and node), each search with a transposition table allocated for that affinity, and
+ * prints csv with the totals of each affinity:
+ *
+ * affinity,threads,depth,time_ms,nodes,nps,tt_hit_rate
+ *
+ * This measures the effect of pinning and of the first touch placement of the table, the configured affinity
+ * is restored afterwards.
+ */
+void bench_numa(int threads, int depth, gunborg::SmpMode smp_mode);
+
+/*
+ * Slider attack lookup benchmark. Times bishop_attacks and rook_attacks on all squares for a fixed set of random
+ * occupied squares and prints the lookups per second of the magic table, and of the pext table if the cpu has pext.
+ *
+ * Then times the slider attack maps of a side by a lookup for each slider, by the SSE2 fill and by the AVX2 fill (if
+ * the cpu has AVX2), for the check test after the moves and the king test in see after the captures of the bench
+ * positions.
+ *
+ * Last it times making and unmaking the moves of the bench positions with the check test after each move, which
+ * compares the attack tables kept by make_move in an INCREMENTAL_ATTACKS build to the ones computed from scratch.
+ */
+void bench_attacks();
+
+#endif /* BENCH_H_ */
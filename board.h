@@ -24,16 +24,12 @@
 #ifndef BOARD_H_
 #define BOARD_H_
 
+#include <algorithm>
 #include <deque>
 #include <inttypes.h>
+#include <new>
 #include <vector>
 
-struct Position {
-	uint64_t p[2][6] = {}; //[WHITE|BLACK][PAWN ... KING]
-	std::vector<uint64_t> meta_info_stack;
-	uint64_t hash_key = 0;
-};
-
 // meta_info:
 // en passant flags on ROW_3 and ROW_6
 // castling rightis on the squares the king castle to, C1, G1, C8 and G8
@@ -181,6 +177,50 @@ static const int KING = 5;
 static const int EN_PASSANT = 6;
 static const int EMPTY = 7;
 
+// the most moves made on a position without unmaking them, the search stays well below it
+const int MAX_PLY = 128;
+
+/*
+ * What make_move needs to restore in unmake_move, one for each ply
+ */
+struct StateInfo {
+	uint64_t meta_info = 0;
+	uint64_t hash_key = 0; // the key of the position when the next move was made
+	int captured_piece = EMPTY; // by the move to this state
+	int halfmove_clock = 0; // plies since the last capture or pawn move
+};
+
+struct Position {
+	uint64_t p[2][6] = {}; //[WHITE|BLACK][PAWN ... KING]
+	uint64_t color_squares[2] = {}; // the pieces of each color, kept up to date by make_move and unmake_move
+	uint64_t occupied_squares = 0;
+	uint8_t board[64] = {}; // the piece type on each square, EMPTY if none
+	StateInfo states[MAX_PLY];
+	int ply = 0; // index of the current state
+	uint64_t hash_key = 0;
+#ifdef INCREMENTAL_ATTACKS
+	// the attack tables, updated by make_move and unmake_move for the squares a move affects
+	uint64_t attacks_from[64] = {}; // the squares attacked by the piece on each square, 0 for an empty square
+	uint64_t attacks_to[64] = {}; // the pieces of both sides attacking each square
+#endif
+};
+
+inline uint64_t occupancy(const Position& position, int color) {
+	return position.color_squares[color];
+}
+
+inline uint64_t occupancy(const Position& position) {
+	return position.occupied_squares;
+}
+
+inline StateInfo& current_state(Position& position) {
+	return position.states[position.ply];
+}
+
+inline const StateInfo& current_state(const Position& position) {
+	return position.states[position.ply];
+}
+
 static const uint64_t BLACK_SQUARES = A1 + A3 + A5 + A7 +
 									  B2 + B4 + B6 + B8 +
 									  C1 + C3 + C5 + C7 +
@@ -287,11 +327,155 @@ inline int pop_count_sw(uint64_t b) {
 #endif
 // TODO Macro for _MSC_VER intrinsics
 
+/*
+ * Functions marked CPU_DISPATCH are compiled once for haswell (popcnt, bmi and avx2), once with popcnt and once
+ * for the baseline cpu, and the best version for the cpu is picked when the program is loaded (gcc function
+ * multiversioning). Inline functions like pop_count are compiled into each version. Builds for a fixed instruction
+ * set (e.g. CFLAGS with -march=native) and targets without ifunc support compile them once.
+ */
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__) && !defined(__POPCNT__)
+	#define CPU_DISPATCH __attribute__((target_clones("arch=haswell", "popcnt", "default")))
+#else
+	#define CPU_DISPATCH
+#endif
+
+#ifdef INCREMENTAL_ATTACKS
+/*
+ * computes the attack tables of the position from scratch
+ */
+void init_attacks(Position& position);
+#endif
+
+/*
+ * computes the occupancy and the board from the piece bitboards, after they are set without make_move
+ */
+inline void init_position(Position& position) {
+	for (int square = 0; square < 64; square++) {
+		position.board[square] = EMPTY;
+	}
+	for (int c = 0; c < 2; c++) {
+		position.color_squares[c] = 0;
+		for (int piece = 0; piece < 6; piece++) {
+			position.color_squares[c] |= position.p[c][piece];
+			for (uint64_t b = position.p[c][piece]; b != 0; b = reset_lsb(b)) {
+				position.board[lsb_to_square(b)] = piece;
+			}
+		}
+	}
+	position.occupied_squares = position.color_squares[WHITE] | position.color_squares[BLACK];
+#ifdef INCREMENTAL_ATTACKS
+	init_attacks(position);
+#endif
+}
+
 
 
 
 typedef std::deque<Position> list;
-typedef std::deque<Move> MoveList;
+
+// more than the legal moves of any position
+const int MAX_MOVES = 256;
+
+/*
+ * A list of moves on the stack, with room for MAX_MOVES moves. The moves are not constructed until they are
+ * added, and only the added moves are copied.
+ */
+class MoveList {
+
+private:
+	alignas(Move) unsigned char buffer[MAX_MOVES * sizeof(Move)];
+	unsigned int count = 0;
+
+	Move* data() {
+		return reinterpret_cast<Move*>(buffer);
+	}
+
+	const Move* data() const {
+		return reinterpret_cast<const Move*>(buffer);
+	}
+
+public:
+	typedef Move* iterator;
+	typedef const Move* const_iterator;
+
+	MoveList() {
+	}
+
+	MoveList(const MoveList& other) {
+		*this = other;
+	}
+
+	MoveList& operator=(const MoveList& other) {
+		count = other.count;
+		std::copy(other.begin(), other.end(), begin());
+		return *this;
+	}
+
+	void push_back(const Move& move) {
+		new (data() + count++) Move(move);
+	}
+
+	void clear() {
+		count = 0;
+	}
+
+	/*
+	 * keeps the first count moves, the list can not grow this way
+	 */
+	void resize(unsigned int new_count) {
+		if (new_count < count) {
+			count = new_count;
+		}
+	}
+
+	unsigned int size() const {
+		return count;
+	}
+
+	bool empty() const {
+		return count == 0;
+	}
+
+	iterator begin() {
+		return data();
+	}
+
+	iterator end() {
+		return data() + count;
+	}
+
+	const_iterator begin() const {
+		return data();
+	}
+
+	const_iterator end() const {
+		return data() + count;
+	}
+
+	Move& front() {
+		return data()[0];
+	}
+
+	const Move& front() const {
+		return data()[0];
+	}
+
+	Move& back() {
+		return data()[count - 1];
+	}
+
+	const Move& back() const {
+		return data()[count - 1];
+	}
+
+	Move& operator[](unsigned int i) {
+		return data()[i];
+	}
+
+	const Move& operator[](unsigned int i) const {
+		return data()[i];
+	}
+};
 
 
 #endif /* BOARD_H_ */
@@ -31,26 +31,81 @@ namespace {
 
 const int MAX_MATERIAL = 3100;
 
+/*
+ * the squares attacked by the bishop or rook on the square, read from the attack tables when they are kept up
+ * to date
+ */
+template<int piece>
+inline uint64_t slider_attacks(const Position& position, int square, uint64_t occupied_squares) {
+#ifdef INCREMENTAL_ATTACKS
+	return position.attacks_from[square];
+#else
+	return piece == BISHOP ? bishop_attacks(occupied_squares, square) : rook_attacks(occupied_squares, square);
+#endif
+}
+
+}
+
+struct EvalTables {
+	int square_proximity[64][64];
+	// piece square tables [WHITE|BLACK][64]
+	int pawn_square_table[2][64];
+	int pawn_square_table_endgame[2][64];
+	int knight_square_table[2][64];
+	int bishop_square_table[2][64];
+	int rook_square_table[2][64];
+	int queen_square_table[2][64];
+	int king_square_table_endgame[2][64];
+};
+
+constexpr int distance(int a, int b) {
+	return a > b ? a - b : b - a;
 }
 
-int square_proximity[64][64];
+// the black tables are the white tables mirrored
+constexpr void set_square_table(int (&square_table)[2][64], const int (&white_square_table)[64]) {
+	for (int i = 0; i < 64; ++i) {
+		square_table[WHITE][i] = white_square_table[i];
+		square_table[BLACK][i] = white_square_table[63 - i];
+	}
+}
+
+constexpr EvalTables generate_eval_tables() {
+	EvalTables tables {};
+	for (int i = 0; i < 64; ++i) {
+		for (int j = 0; j < 64; ++j) {
+			int rows = distance(i / 8, j / 8);
+			int files = distance(i % 8, j % 8);
+			tables.square_proximity[i][j] = 7 - (rows > files ? rows : files);
+		}
+	}
+	set_square_table(tables.pawn_square_table, PAWN_SQUARE_TABLE);
+	set_square_table(tables.pawn_square_table_endgame, PAWN_SQUARE_TABLE_ENDGAME);
+	set_square_table(tables.knight_square_table, KNIGHT_SQUARE_TABLE);
+	set_square_table(tables.bishop_square_table, BISHOP_SQUARE_TABLE);
+	set_square_table(tables.rook_square_table, ROOK_SQUARE_TABLE);
+	set_square_table(tables.queen_square_table, QUEEN_SQUARE_TABLE);
+	set_square_table(tables.king_square_table_endgame, KING_SQUARE_TABLE_ENDGAME);
+	return tables;
+}
 
-// piece square tables [WHITE|BLACK][64]
-// values are set by init_eval()
-int pawn_square_table[2][64];
-int pawn_square_table_endgame[2][64];
-int knight_square_table[2][64];
-int bishop_square_table[2][64];
-int rook_square_table[2][64];
-int queen_square_table[2][64];
-int king_square_table_endgame[2][64];
+// generated by the compiler, read only data
+constexpr EvalTables EVAL_TABLES = generate_eval_tables();
+constexpr const int (&square_proximity)[64][64] = EVAL_TABLES.square_proximity;
+constexpr const int (&pawn_square_table)[2][64] = EVAL_TABLES.pawn_square_table;
+constexpr const int (&pawn_square_table_endgame)[2][64] = EVAL_TABLES.pawn_square_table_endgame;
+constexpr const int (&knight_square_table)[2][64] = EVAL_TABLES.knight_square_table;
+constexpr const int (&bishop_square_table)[2][64] = EVAL_TABLES.bishop_square_table;
+constexpr const int (&rook_square_table)[2][64] = EVAL_TABLES.rook_square_table;
+constexpr const int (&queen_square_table)[2][64] = EVAL_TABLES.queen_square_table;
+constexpr const int (&king_square_table_endgame)[2][64] = EVAL_TABLES.king_square_table_endgame;
 
 // returns the score from the playing side's perspective
 int nega_evaluate(const Position& position, const bool& white_turn) {
 	return white_turn ? evaluate(position) : -evaluate(position);
 }
 
-int evaluate_side(const Position& position, const int& side, const int& piece_material, const int& opponent_piece_material) {
+CPU_DISPATCH int evaluate_side(const Position& position, const int& side, const int& piece_material, const int& opponent_piece_material) {
 	int score = 0;
 	int end_game_score = 0;
 	int middle_game_score = 0;
@@ -65,13 +120,8 @@ int evaluate_side(const Position& position, const int& side, const int& piece_ma
 	int king_square = lsb_to_square(king);
 	int opponent_king_square = lsb_to_square(opponent_king);
 
-	uint64_t opponent_squares = position.p[opponent][KING] | position.p[opponent][PAWN] | position.p[opponent][KNIGHT]
-			| position.p[opponent][BISHOP] | position.p[opponent][ROOK] | position.p[opponent][QUEEN];
-
-	uint64_t side_squares = position.p[side][KING] | position.p[side][PAWN] | position.p[side][KNIGHT]
-			| position.p[side][BISHOP] | position.p[side][ROOK] | position.p[side][QUEEN];
-
-	uint64_t occupied_squares = opponent_squares | side_squares;
+	uint64_t side_squares = occupancy(position, side);
+	uint64_t occupied_squares = occupancy(position);
 
 	uint64_t pawns = position.p[side][PAWN];
 	while (pawns) {
@@ -91,7 +141,7 @@ int evaluate_side(const Position& position, const int& side, const int& piece_ma
 	while (bishops) {
 		int i = lsb_to_square(bishops);
 		score += bishop_square_table[side][i];
-		score += BISHOP_MOBILITY_BONUS * (pop_count(bishop_attacks(occupied_squares, i) & ~side_squares) - 5);
+		score += BISHOP_MOBILITY_BONUS * (pop_count(slider_attacks<BISHOP>(position, i, occupied_squares) & ~side_squares) - 5);
 		opponent_king_proximity_bonus += square_proximity[opponent_king_square][i] * BISHOP_KING_PROXIMITY_BONUS;
 		bishops = reset_lsb(bishops);
 	}
@@ -125,7 +175,7 @@ int evaluate_side(const Position& position, const int& side, const int& piece_ma
 	while (rooks) {
 		int i = lsb_to_square(rooks);
 		score += rook_square_table[side][i];
-		score += ROOK_MOBILITY_BONUS * (pop_count(rook_attacks(occupied_squares, i) & ~side_squares) - 5);
+		score += ROOK_MOBILITY_BONUS * (pop_count(slider_attacks<ROOK>(position, i, occupied_squares) & ~side_squares) - 5);
 		opponent_king_proximity_bonus += square_proximity[opponent_king_square][i] * ROOK_KING_PROXIMITY_BONUS;
 		rooks = reset_lsb(rooks);
 	}
@@ -163,7 +213,7 @@ int evaluate_side(const Position& position, const int& side, const int& piece_ma
 	return score;
 }
 
-bool is_drawish_endgame(const Position& position) {
+CPU_DISPATCH bool is_drawish_endgame(const Position& position) {
 	if (pop_count(
 			position.p[WHITE][QUEEN] | position.p[BLACK][QUEEN]) != 0 ||
 		pop_count(
@@ -226,7 +276,7 @@ bool is_drawish_endgame(const Position& position) {
 }
 
 // score in centipawns
-int evaluate(const Position& position) {
+CPU_DISPATCH int evaluate(const Position& position) {
 	uint64_t black_king = position.p[BLACK][KING];
 	uint64_t white_king = position.p[WHITE][KING];
 	if (black_king == 0) {
@@ -311,30 +361,3 @@ int evaluate(const Position& position) {
 
 	return score;
 }
-
-void init_eval() {
-	for (int i = 0; i < 64; ++i) {
-		for (int j = 0; j < 64; ++j) {
-			int row_i = i / 8;
-			int file_i = i % 8;
-			int row_j = j / 8;
-			int file_j = j % 8;
-			square_proximity[i][j] = 7 - std::max(std::abs(file_i - file_j), std::abs(row_i - row_j));
-		}
-		rook_square_table[WHITE][i] = ROOK_SQUARE_TABLE[i];
-		rook_square_table[BLACK][i] = ROOK_SQUARE_TABLE[63-i];
-		knight_square_table[WHITE][i] = KNIGHT_SQUARE_TABLE[i];
-		knight_square_table[BLACK][i] = KNIGHT_SQUARE_TABLE[63-i];
-		bishop_square_table[WHITE][i] = BISHOP_SQUARE_TABLE[i];
-		bishop_square_table[BLACK][i] = BISHOP_SQUARE_TABLE[63-i];
-		king_square_table_endgame[WHITE][i] = KING_SQUARE_TABLE_ENDGAME[i];
-		king_square_table_endgame[BLACK][i] = KING_SQUARE_TABLE_ENDGAME[63-i];
-		pawn_square_table[WHITE][i] = PAWN_SQUARE_TABLE[i];
-		pawn_square_table[BLACK][i] = PAWN_SQUARE_TABLE[63-i];
-		pawn_square_table_endgame[WHITE][i] = PAWN_SQUARE_TABLE_ENDGAME[i];
-		pawn_square_table_endgame[BLACK][i] = PAWN_SQUARE_TABLE_ENDGAME[63-i];
-		queen_square_table[WHITE][i] = QUEEN_SQUARE_TABLE[i];
-		queen_square_table[BLACK][i] = QUEEN_SQUARE_TABLE[63-i];
-	}
-
-}
@@ -145,7 +145,4 @@ int evaluate(const Position& position);
  */
 int nega_evaluate(const Position& position, const bool& white_turn);
 
-void init_eval();
-
-
 #endif /* EVAL_H_ */
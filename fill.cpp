@@ -0,0 +1,190 @@
+/*
+ * Gunborg - UCI chess engine
+ * Copyright (C) 2013-2015 Torbjörn Nilsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * fill.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Torbjörn Nilsson
+ */
+
+#include "fill.h"
+#include "board.h"
+#include "magic.h"
+
+#if defined(__x86_64__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const uint64_t NOT_A_FILE = ~A_FILE;
+const uint64_t NOT_H_FILE = ~H_FILE;
+
+/*
+ * the attacks of the generators in the direction of a left shift (shift > 0) or right shift (shift < 0), wrap masks
+ * the squares that are not reached by wrapping around the board
+ */
+inline uint64_t fill_attacks(uint64_t generators, uint64_t empty_squares, int shift, uint64_t wrap) {
+	uint64_t propagators = empty_squares & wrap;
+	if (shift > 0) {
+		generators |= propagators & (generators << shift);
+		propagators &= propagators << shift;
+		generators |= propagators & (generators << 2 * shift);
+		propagators &= propagators << 2 * shift;
+		generators |= propagators & (generators << 4 * shift);
+		return (generators << shift) & wrap;
+	}
+	shift = -shift;
+	generators |= propagators & (generators >> shift);
+	propagators &= propagators >> shift;
+	generators |= propagators & (generators >> 2 * shift);
+	propagators &= propagators >> 2 * shift;
+	generators |= propagators & (generators >> 4 * shift);
+	return (generators >> shift) & wrap;
+}
+
+inline uint64_t lookup_slider_attack_map(uint64_t diagonal_sliders, uint64_t straight_sliders,
+		uint64_t occupied_squares) {
+	uint64_t attacked_squares = 0;
+	for (; diagonal_sliders; diagonal_sliders = reset_lsb(diagonal_sliders)) {
+		attacked_squares |= bishop_attacks(occupied_squares, lsb_to_square(diagonal_sliders));
+	}
+	for (; straight_sliders; straight_sliders = reset_lsb(straight_sliders)) {
+		attacked_squares |= rook_attacks(occupied_squares, lsb_to_square(straight_sliders));
+	}
+	return attacked_squares;
+}
+
+#if defined(__x86_64__) || defined(__SSE2__)
+
+/*
+ * fills the two lanes to the left by shift, the lanes have the same shift and wrap
+ */
+inline __m128i sse2_fill_attacks(__m128i generators, __m128i empty_squares, int shift, __m128i wrap) {
+	__m128i propagators = _mm_and_si128(empty_squares, wrap);
+	for (int i = 0; i < 3; i++) {
+		generators = _mm_or_si128(generators, _mm_and_si128(propagators, _mm_slli_epi64(generators, shift)));
+		propagators = _mm_and_si128(propagators, _mm_slli_epi64(propagators, shift));
+		shift *= 2;
+	}
+	return _mm_and_si128(_mm_slli_epi64(generators, shift / 8), wrap);
+}
+
+/*
+ * north, east, north east and north west in one register and south, west, south west and south east in the other
+ */
+__attribute__((target("avx2"))) inline uint64_t avx2_slider_attack_map(uint64_t diagonal_sliders,
+		uint64_t straight_sliders, uint64_t occupied_squares) {
+	const __m256i shifts = _mm256_setr_epi64x(8, 1, 9, 7);
+	const __m256i left_wraps = _mm256_setr_epi64x(~0ULL, NOT_A_FILE, NOT_A_FILE, NOT_H_FILE);
+	const __m256i right_wraps = _mm256_setr_epi64x(~0ULL, NOT_H_FILE, NOT_H_FILE, NOT_A_FILE);
+	__m256i empty_squares = _mm256_set1_epi64x(~occupied_squares);
+	__m256i left_generators = _mm256_setr_epi64x(straight_sliders, straight_sliders, diagonal_sliders,
+			diagonal_sliders);
+	__m256i right_generators = left_generators;
+	__m256i left_propagators = _mm256_and_si256(empty_squares, left_wraps);
+	__m256i right_propagators = _mm256_and_si256(empty_squares, right_wraps);
+	__m256i lane_shifts = shifts;
+	for (int i = 0; i < 3; i++) {
+		left_generators = _mm256_or_si256(left_generators,
+				_mm256_and_si256(left_propagators, _mm256_sllv_epi64(left_generators, lane_shifts)));
+		left_propagators = _mm256_and_si256(left_propagators, _mm256_sllv_epi64(left_propagators, lane_shifts));
+		right_generators = _mm256_or_si256(right_generators,
+				_mm256_and_si256(right_propagators, _mm256_srlv_epi64(right_generators, lane_shifts)));
+		right_propagators = _mm256_and_si256(right_propagators, _mm256_srlv_epi64(right_propagators, lane_shifts));
+		lane_shifts = _mm256_add_epi64(lane_shifts, lane_shifts);
+	}
+	__m256i attacks = _mm256_or_si256(_mm256_and_si256(_mm256_sllv_epi64(left_generators, shifts), left_wraps),
+			_mm256_and_si256(_mm256_srlv_epi64(right_generators, shifts), right_wraps));
+	__m128i half = _mm_or_si128(_mm256_castsi256_si128(attacks), _mm256_extracti128_si256(attacks, 1));
+	return _mm_cvtsi128_si64(_mm_or_si128(half, _mm_unpackhi_epi64(half, half)));
+}
+
+#endif
+
+}
+
+uint64_t magic_slider_attack_map(uint64_t diagonal_sliders, uint64_t straight_sliders, uint64_t occupied_squares) {
+	return lookup_slider_attack_map(diagonal_sliders, straight_sliders, occupied_squares);
+}
+
+/*
+ * north, north east and north west on the board in the low lane, and on the vertically flipped board in the high lane,
+ * which is south, south east and south west on the board. East and west are filled without sse.
+ */
+uint64_t sse2_slider_attack_map(uint64_t diagonal_sliders, uint64_t straight_sliders, uint64_t occupied_squares) {
+#if defined(__x86_64__) || defined(__SSE2__)
+	uint64_t empty_squares = ~occupied_squares;
+	__m128i empty_lanes = _mm_set_epi64x(__builtin_bswap64(empty_squares), empty_squares);
+	__m128i straight_lanes = _mm_set_epi64x(__builtin_bswap64(straight_sliders), straight_sliders);
+	__m128i diagonal_lanes = _mm_set_epi64x(__builtin_bswap64(diagonal_sliders), diagonal_sliders);
+	__m128i attacks = sse2_fill_attacks(straight_lanes, empty_lanes, 8, _mm_set1_epi64x(~0ULL));
+	attacks = _mm_or_si128(attacks, sse2_fill_attacks(diagonal_lanes, empty_lanes, 9, _mm_set1_epi64x(NOT_A_FILE)));
+	attacks = _mm_or_si128(attacks, sse2_fill_attacks(diagonal_lanes, empty_lanes, 7, _mm_set1_epi64x(NOT_H_FILE)));
+	uint64_t north_attacks = _mm_cvtsi128_si64(attacks);
+	uint64_t south_attacks = __builtin_bswap64(_mm_cvtsi128_si64(_mm_unpackhi_epi64(attacks, attacks)));
+	return north_attacks | south_attacks | fill_attacks(straight_sliders, empty_squares, 1, NOT_A_FILE)
+			| fill_attacks(straight_sliders, empty_squares, -1, NOT_H_FILE);
+#else
+	uint64_t empty_squares = ~occupied_squares;
+	return fill_attacks(straight_sliders, empty_squares, 8, ~0ULL)
+			| fill_attacks(straight_sliders, empty_squares, -8, ~0ULL)
+			| fill_attacks(straight_sliders, empty_squares, 1, NOT_A_FILE)
+			| fill_attacks(straight_sliders, empty_squares, -1, NOT_H_FILE)
+			| fill_attacks(diagonal_sliders, empty_squares, 9, NOT_A_FILE)
+			| fill_attacks(diagonal_sliders, empty_squares, 7, NOT_H_FILE)
+			| fill_attacks(diagonal_sliders, empty_squares, -7, NOT_A_FILE)
+			| fill_attacks(diagonal_sliders, empty_squares, -9, NOT_H_FILE);
+#endif
+}
+
+#if defined(FILL_DISPATCH)
+
+__attribute__((target("avx2"))) uint64_t slider_attack_map(uint64_t diagonal_sliders, uint64_t straight_sliders,
+		uint64_t occupied_squares) {
+	return avx2_slider_attack_map(diagonal_sliders, straight_sliders, occupied_squares);
+}
+
+__attribute__((target("default"))) uint64_t slider_attack_map(uint64_t diagonal_sliders, uint64_t straight_sliders,
+		uint64_t occupied_squares) {
+	return lookup_slider_attack_map(diagonal_sliders, straight_sliders, occupied_squares);
+}
+
+const char* slider_attack_map_backend() {
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") ? "avx2 fill" : "magic";
+}
+
+#else
+
+uint64_t slider_attack_map(uint64_t diagonal_sliders, uint64_t straight_sliders, uint64_t occupied_squares) {
+#ifdef __AVX2__
+	return avx2_slider_attack_map(diagonal_sliders, straight_sliders, occupied_squares);
+#else
+	return lookup_slider_attack_map(diagonal_sliders, straight_sliders, occupied_squares);
+#endif
+}
+
+const char* slider_attack_map_backend() {
+#ifdef __AVX2__
+	return "avx2 fill";
+#else
+	return "magic";
+#endif
+}
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * Gunborg - UCI chess engine
+ * Copyright (C) 2013-2015 Torbjörn Nilsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * fill.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Torbjörn Nilsson
+ */
+
+#ifndef FILL_H_
+#define FILL_H_
+
+#include <inttypes.h>
+
+/*
+ * Kogge-Stone occluded fill of all sliders of a side at once, an alternative to looking up the attacks of each slider.
+ *
+ * The eight directions are filled in parallel lanes: with AVX2 the four left shifting directions in one register and
+ * the four right shifting in another, with SSE2 north and south (and the diagonals) share a register by flipping the
+ * board vertically in the second lane.
+ *
+ * See http://chessprogramming.wikispaces.com/Kogge-Stone+Algorithm
+ */
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__) && !defined(__AVX2__)
+	#define FILL_DISPATCH
+#endif
+
+/*
+ * the squares attacked by the diagonal sliders (bishops and queens) and the straight sliders (rooks and queens) when
+ * occupied_squares are occupied. With the AVX2 fill on cpus that have it, picked at load time, otherwise by a lookup
+ * for each slider, which is faster than the SSE2 fill (see bench attacks).
+ */
+#ifdef FILL_DISPATCH
+__attribute__((target("avx2"))) uint64_t slider_attack_map(uint64_t diagonal_sliders, uint64_t straight_sliders,
+		uint64_t occupied_squares);
+__attribute__((target("default"))) uint64_t slider_attack_map(uint64_t diagonal_sliders, uint64_t straight_sliders,
+		uint64_t occupied_squares);
+#else
+uint64_t slider_attack_map(uint64_t diagonal_sliders, uint64_t straight_sliders, uint64_t occupied_squares);
+#endif
+
+/*
+ * the implementation slider_attack_map uses, "avx2 fill" or "magic"
+ */
+const char* slider_attack_map_backend();
+
+/*
+ * the attack map by a lookup for each slider
+ */
+uint64_t magic_slider_attack_map(uint64_t diagonal_sliders, uint64_t straight_sliders, uint64_t occupied_squares);
+
+/*
+ * the attack map by the SSE2 fill, or by the fill without SIMD on cpus without SSE2
+ */
+uint64_t sse2_slider_attack_map(uint64_t diagonal_sliders, uint64_t straight_sliders, uint64_t occupied_squares);
+
+#endif /* FILL_H_ */
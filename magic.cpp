@@ -24,8 +24,6 @@
 #include "magic.h"
 #include <inttypes.h>
 
-uint64_t ray_moves[8][64];
-
 const int N = 0;
 const int NE = 1;
 const int E = 2;
@@ -35,14 +33,9 @@ const int SW = 5;
 const int W = 6;
 const int NW = 7;
 
-uint64_t attack_set_table[107648]; // all possible attack sets for bishops and rooks
-
-AttackSetLookup bishop_lookup_table[64];
-AttackSetLookup rook_lookup_table[64];
-
 // Magic numbers generated using Tord Romstad's proposal at http://chessprogramming.wikispaces.com/Looking+for+Magics
 
-const uint64_t ROOK_MAGICS[64] = {
+constexpr uint64_t ROOK_MAGICS[64] = {
   0xa8002c000108020ULL,
   0x6c00049b0002001ULL,
   0x100200010090040ULL,
@@ -109,7 +102,7 @@ const uint64_t ROOK_MAGICS[64] = {
   0x26002114058042ULL,
 };
 
-const uint64_t BISHOP_MAGICS[64] = {
+constexpr uint64_t BISHOP_MAGICS[64] = {
   0x89a1121896040240ULL,
   0x2004844802002010ULL,
   0x2068080051921000ULL,
@@ -178,7 +171,7 @@ const uint64_t BISHOP_MAGICS[64] = {
 
 // Begin code snippet from Tord Romstad's magic generator(relevant bits/square and mask generation)
 
-const int ROOK_BITS[64] = {
+constexpr int ROOK_BITS[64] = {
   12, 11, 11, 11, 11, 11, 11, 12,
   11, 10, 10, 10, 10, 10, 10, 11,
   11, 10, 10, 10, 10, 10, 10, 11,
@@ -189,7 +182,7 @@ const int ROOK_BITS[64] = {
   12, 11, 11, 11, 11, 11, 11, 12
 };
 
-const int BISHOP_BITS[64] = {
+constexpr int BISHOP_BITS[64] = {
   6, 5, 5, 5, 5, 5, 5, 6,
   5, 5, 5, 5, 5, 5, 5, 5,
   5, 5, 7, 7, 7, 7, 5, 5,
@@ -200,9 +193,9 @@ const int BISHOP_BITS[64] = {
   6, 5, 5, 5, 5, 5, 5, 6
 };
 
-uint64_t rook_mask(int square) {
+constexpr uint64_t rook_mask(int square) {
 	uint64_t result = 0ULL;
-	int rank = square / 8, file = square % 8, r, f;
+	int rank = square / 8, file = square % 8, r = 0, f = 0;
 	for (r = rank + 1; r <= 6; r++)
 		result |= (1ULL << (file + r * 8));
 	for (r = rank - 1; r >= 1; r--)
@@ -214,9 +207,9 @@ uint64_t rook_mask(int square) {
 	return result;
 }
 
-uint64_t bishop_mask(int square) {
+constexpr uint64_t bishop_mask(int square) {
 	uint64_t result = 0ULL;
-	int rank = square / 8, file = square % 8, r, f;
+	int rank = square / 8, file = square % 8, r = 0, f = 0;
 	for (r = rank + 1, f = file + 1; r <= 6 && f <= 6; r++, f++)
 		result |= (1ULL << (f + r * 8));
 	for (r = rank + 1, f = file - 1; r <= 6 && f >= 1; r++, f--)
@@ -230,159 +223,159 @@ uint64_t bishop_mask(int square) {
 
 // end code snippet
 
+struct RayMoves {
+	uint64_t squares[8][64];
+};
+
+constexpr RayMoves generate_ray_moves() {
+	const int FILE_STEPS[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+	const int RANK_STEPS[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+	RayMoves ray_moves {};
+	for (int dir = 0; dir < 8; dir++) {
+		for (int i = 0; i < 64; i++) {
+			int file = i % 8 + FILE_STEPS[dir];
+			int rank = i / 8 + RANK_STEPS[dir];
+			for (; file >= 0 && file < 8 && rank >= 0 && rank < 8; file += FILE_STEPS[dir], rank += RANK_STEPS[dir]) {
+				ray_moves.squares[dir][i] |= 1ULL << (rank * 8 + file);
+			}
+		}
+	}
+	return ray_moves;
+}
+
+// the squares from a square to the border in each direction
+constexpr RayMoves RAY_MOVES = generate_ray_moves();
+constexpr const uint64_t (&ray_moves)[8][64] = RAY_MOVES.squares;
+
 /**
  * Ray for direction N E NE NW
  */
-uint64_t get_positive_ray_moves(const int& dir, const int& from, const uint64_t& occupied_squares) {
-	uint64_t attacked_squares = ray_moves[dir][from];
-	uint64_t blocker = attacked_squares & occupied_squares;
-	attacked_squares ^= ray_moves[dir][lsb_to_square(blocker | H8)];
-	return attacked_squares;
+constexpr uint64_t get_positive_ray_moves(const int dir, const int from, const uint64_t occupied_squares) {
+	return ray_moves[dir][from] ^ ray_moves[dir][lsb_to_square((ray_moves[dir][from] & occupied_squares) | H8)];
 }
 
 /**
  * Ray for direction S W SW SE
  */
-uint64_t get_negative_ray_moves(const int& dir, const int& from, const uint64_t& occupied_squares) {
-	uint64_t attacked_squares = ray_moves[dir][from];
-	uint64_t blocker = attacked_squares & occupied_squares;
-	attacked_squares ^= ray_moves[dir][msb_to_square(blocker | A1)];
-	return attacked_squares;
+constexpr uint64_t get_negative_ray_moves(const int dir, const int from, const uint64_t occupied_squares) {
+	return ray_moves[dir][from] ^ ray_moves[dir][msb_to_square((ray_moves[dir][from] & occupied_squares) | A1)];
 }
 
-void init_ray_moves() {
-	for (int i = 0; i < 64; i++) {
-		uint64_t b = 1ULL << i;
-		uint64_t to_squares = 0;
-		while (b & ~ROW_8) {
-			b = b << 8UL;
-			to_squares |= b;
-		}
-		ray_moves[N][i] = to_squares;
-	}
-	for (int i = 0; i < 64; i++) {
-		uint64_t b = 1ULL << i;
-		uint64_t to_squares = 0;
-		while (b & ~ROW_1) {
-			b = b >> 8UL;
-			to_squares |= b;
-		}
-		ray_moves[S][i] = to_squares;
-	}
-	for (int i = 0; i < 64; i++) {
-		uint64_t b = 1ULL << i;
-		uint64_t to_squares = 0;
-		while (b & ~H_FILE) {
-			b = b << 1ULL;
-			to_squares |= b;
-		}
-		ray_moves[E][i] = to_squares;
-	}
-	for (int i = 0; i < 64; i++) {
-		uint64_t b = 1ULL << i;
-		uint64_t to_squares = 0;
-		while (b & ~A_FILE) {
-			b = b >> 1ULL;
-			to_squares |= b;
-		}
-		ray_moves[W][i] = to_squares;
-	}
-	for (int i = 0; i < 64; i++) {
-		uint64_t b = 1ULL << i;
-		uint64_t to_squares = 0;
-		while (b & ~NW_BORDER) {
-			b = b << 7UL;
-			to_squares |= b;
-		}
-		ray_moves[NW][i] = to_squares;
-	}
-	for (int i = 0; i < 64; i++) {
-		uint64_t b = 1ULL << i;
-		uint64_t to_squares = 0;
-		while (b & ~SW_BORDER) {
-			b = b >> 9UL;
-			to_squares |= b;
-		}
-		ray_moves[SW][i] = to_squares;
-	}
-	for (int i = 0; i < 64; i++) {
-		uint64_t b = 1ULL << i;
-		uint64_t to_squares = 0;
-		while (b & ~NE_BORDER) {
-			b = b << 9UL;
-			to_squares |= b;
-		}
-		ray_moves[NE][i] = to_squares;
+constexpr uint64_t get_bishop_ray_moves(const int square, const uint64_t occupied_squares) {
+	return get_positive_ray_moves(NW, square, occupied_squares) | get_positive_ray_moves(NE, square, occupied_squares)
+			| get_negative_ray_moves(SW, square, occupied_squares) | get_negative_ray_moves(SE, square, occupied_squares);
+}
+
+constexpr uint64_t get_rook_ray_moves(const int square, const uint64_t occupied_squares) {
+	return get_positive_ray_moves(N, square, occupied_squares) | get_positive_ray_moves(E, square, occupied_squares)
+			| get_negative_ray_moves(W, square, occupied_squares) | get_negative_ray_moves(S, square, occupied_squares);
+}
+
+/*
+ * the index of an attack set in the table of a square, where occupied_squares is the n:th subset of the mask in the
+ * order (occupied_squares - mask) & mask steps through them. That order packs the subsets like pext does, so the
+ * n:th subset has the pext index n.
+ */
+constexpr int get_initial_lookup_index(uint64_t occupied_squares, int n, const AttackSetLookup& lookup, bool pext) {
+	return pext ? n : get_lookup_offset(occupied_squares, lookup.magic, lookup.shift);
+}
+
+constexpr int attack_set_table_offset(int square, bool rook) {
+	int offset = 0;
+	for (int i = 0; i < square; i++) {
+		offset += (1 << BISHOP_BITS[i]) + (1 << ROOK_BITS[i]);
 	}
-	for (int i = 0; i < 64; i++) {
-		uint64_t b = 1ULL << i;
-		uint64_t to_squares = 0;
-		while (b & ~SE_BORDER) {
-			b = b >> 7UL;
-			to_squares |= b;
+	return rook ? offset + (1 << BISHOP_BITS[square]) : offset;
+}
+
+constexpr AttackSetLookup generate_lookup(int square, bool rook, const uint64_t* attack_sets,
+		const uint64_t* pext_attack_sets) {
+	AttackSetLookup lookup {};
+	lookup.attack_set_table_ptr = attack_sets ? attack_sets + attack_set_table_offset(square, rook) : nullptr;
+#ifdef PEXT_DISPATCH
+	lookup.pext_attack_set_table_ptr = pext_attack_sets ? pext_attack_sets + attack_set_table_offset(square, rook)
+			: nullptr;
+#endif
+	lookup.mask = rook ? rook_mask(square) : bishop_mask(square);
+	lookup.magic = rook ? ROOK_MAGICS[square] : BISHOP_MAGICS[square];
+	lookup.shift = 64 - (rook ? ROOK_BITS[square] : BISHOP_BITS[square]);
+	return lookup;
+}
+
+struct AttackSetTable {
+	uint64_t attack_sets[107648]; // all possible attack sets for bishops and rooks
+};
+
+constexpr AttackSetTable generate_attack_set_table(bool pext) {
+	AttackSetTable table {};
+	for (int square = 0; square < 64; square++) {
+		for (int rook = 0; rook < 2; rook++) {
+			AttackSetLookup lookup = generate_lookup(square, rook, nullptr, nullptr);
+			uint64_t* attack_sets = &table.attack_sets[attack_set_table_offset(square, rook)];
+
+			// loop over all possible combinations of bits set in the mask
+			uint64_t occupied_squares = 0;
+			int n = 0;
+			do {
+				attack_sets[get_initial_lookup_index(occupied_squares, n++, lookup, pext)] =
+						rook ? get_rook_ray_moves(square, occupied_squares) : get_bishop_ray_moves(square, occupied_squares);
+				occupied_squares = (occupied_squares - lookup.mask) & lookup.mask;
+			} while (occupied_squares);
 		}
-		ray_moves[SE][i] = to_squares;
 	}
+	return table;
 }
 
-void init_magic_lookup_table() {
-
-	init_ray_moves();
-
-	int attack_table_offset = 0;
-	for (int square = 0; square < 64; ++square) {
-
-		// generate all possible bishop attack sets
-
-		uint64_t b_mask = bishop_mask(square);
-		uint64_t* bishop_attack_table_ptr = &attack_set_table[attack_table_offset];
-
-		AttackSetLookup bishop_lookup;
-		bishop_lookup.attack_set_table_ptr = bishop_attack_table_ptr;
-		bishop_lookup.magic = BISHOP_MAGICS[square];
-		bishop_lookup.mask = b_mask;
-		bishop_lookup.shift = 64 - BISHOP_BITS[square];
-		bishop_lookup_table[square] = bishop_lookup;
-
-		// loop over all possible combinations of bits set in the mask
-		uint64_t occupied_squares = 0;
-		do {
-			uint64_t to_squares = get_positive_ray_moves(NW, square, occupied_squares)
-					| get_positive_ray_moves(NE, square, occupied_squares)
-					| get_negative_ray_moves(SW, square, occupied_squares)
-					| get_negative_ray_moves(SE, square, occupied_squares);
-
-			int key = get_lookup_offset(occupied_squares, BISHOP_MAGICS[square], 64 - BISHOP_BITS[square]);
-			bishop_attack_table_ptr[key] = to_squares;
-			occupied_squares = (occupied_squares - b_mask) & b_mask;
-			attack_table_offset++;
-		} while (occupied_squares);
-
-		// generate all possible rook attack sets
-
-		uint64_t r_mask = rook_mask(square);
-		uint64_t* rook_attack_table_ptr = &attack_set_table[attack_table_offset];
-
-		AttackSetLookup rook_lookup;
-		rook_lookup.attack_set_table_ptr = rook_attack_table_ptr;
-		rook_lookup.magic = ROOK_MAGICS[square];
-		rook_lookup.mask = r_mask;
-		rook_lookup.shift = 64 - ROOK_BITS[square];
-		rook_lookup_table[square] = rook_lookup;
-
-		// loop over all possible combinations of bits set in the mask
-		occupied_squares = 0;
-		do {
-			uint64_t to_squares = get_positive_ray_moves(N, square, occupied_squares)
-					| get_positive_ray_moves(E, square, occupied_squares)
-					| get_negative_ray_moves(W, square, occupied_squares)
-					| get_negative_ray_moves(S, square, occupied_squares);
-
-			int key = get_lookup_offset(occupied_squares, ROOK_MAGICS[square], 64 - ROOK_BITS[square]);
-			rook_attack_table_ptr[key] = to_squares;
-			occupied_squares = (occupied_squares - r_mask) & r_mask;
-
-			attack_table_offset++;
-		} while (occupied_squares);
+constexpr AttackSetLookupTable generate_lookup_table(bool rook, const uint64_t* attack_sets,
+		const uint64_t* pext_attack_sets) {
+	AttackSetLookupTable lookup_table {};
+	for (int square = 0; square < 64; square++) {
+		lookup_table.squares[square] = generate_lookup(square, rook, attack_sets, pext_attack_sets);
 	}
+	return lookup_table;
+}
+
+/*
+ * The tables are generated by the compiler, so they are read only data shared by all processes. Only the choice
+ * between the magic and the pext table is made at startup.
+ */
+constexpr AttackSetTable attack_set_table = generate_attack_set_table(false);
+
+#ifdef PEXT_DISPATCH
+constexpr AttackSetTable pext_attack_set_table = generate_attack_set_table(true);
+
+constexpr AttackSetLookupTable bishop_lookup_table = generate_lookup_table(false, attack_set_table.attack_sets,
+		pext_attack_set_table.attack_sets);
+constexpr AttackSetLookupTable rook_lookup_table = generate_lookup_table(true, attack_set_table.attack_sets,
+		pext_attack_set_table.attack_sets);
+
+bool fast_pext() {
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("bmi2") && !__builtin_cpu_is("amdfam15h") && !__builtin_cpu_is("amdfam17h");
+}
+
+bool use_pext = fast_pext();
+
+void set_pext_attacks(bool pext) {
+	__builtin_cpu_init();
+	use_pext = pext && __builtin_cpu_supports("bmi2");
+}
+
+const char* attack_backend() {
+	return use_pext ? "pext" : "magic";
+}
+#else
+constexpr AttackSetLookupTable bishop_lookup_table = generate_lookup_table(false, attack_set_table.attack_sets, nullptr);
+constexpr AttackSetLookupTable rook_lookup_table = generate_lookup_table(true, attack_set_table.attack_sets, nullptr);
+
+bool fast_pext() {
+	return false;
+}
+
+void set_pext_attacks(bool) {
+}
+
+const char* attack_backend() {
+	return "magic";
 }
+#endif
@@ -26,11 +26,6 @@
 
 #include <inttypes.h>
 
-/*
- * Must be called first to initialize the attack sets
- */
-void init_magic_lookup_table();
-
 /*
  * Magic bit boards.
  *
@@ -39,37 +34,87 @@ void init_magic_lookup_table();
  * Square + occupied_squares mask, using some magic numbers, gives the correct index in the table.
  *
  * See http://chessprogramming.wikispaces.com/Magic+Bitboards
+ *
+ * On x86-64 there is a second table indexed by the masked occupied squares packed into the low bits with pext
+ * (BMI2), which replaces the multiplication and shift. The table is picked when the program starts, pext on the
+ * cpus that have a fast pext and the magic index otherwise, so one binary runs on all cpus.
  */
+#if defined(__GNUC__) && defined(__x86_64__)
+	#define PEXT_DISPATCH
+#endif
 
 struct AttackSetLookup {
-	uint64_t* attack_set_table_ptr;  // pointer to attack_table for each particular square
+	const uint64_t* attack_set_table_ptr;  // pointer to attack_table for each particular square
+#ifdef PEXT_DISPATCH
+	const uint64_t* pext_attack_set_table_ptr;  // the same attack sets in pext index order
+#endif
 	uint64_t mask;  // to mask relevant squares of both lines (no outer squares)
 	uint64_t magic; // magic 64-bit factor
 	int shift; // shift right (64 - number of bits)
 };
 
-extern AttackSetLookup bishop_lookup_table[64];
-extern AttackSetLookup rook_lookup_table[64];
+struct AttackSetLookupTable {
+	AttackSetLookup squares[64];
+};
+
+extern const AttackSetLookupTable bishop_lookup_table;
+extern const AttackSetLookupTable rook_lookup_table;
 
+#ifdef PEXT_DISPATCH
+// true if the pext table is used, set when the program starts. Lookups before that use the magic table
+extern bool use_pext;
 
-inline int get_lookup_offset(uint64_t occupied_squares, uint64_t magic, int shift) {
+/*
+ * pext as inline assembly, so it can be compiled into code for any x86-64 cpu and only executed when use_pext is set
+ */
+inline uint64_t pext(uint64_t source, uint64_t mask) {
+	uint64_t result;
+	asm("pextq %2, %1, %0" : "=r" (result) : "r" (source), "rm" (mask));
+	return result;
+}
+#endif
+
+constexpr int get_lookup_offset(uint64_t occupied_squares, uint64_t magic, int shift) {
 	return (int) ((occupied_squares * magic) >> shift);
 }
 
+/*
+ * the attack set of the occupied squares in the table of a square
+ */
+inline uint64_t lookup_attacks(uint64_t occupied_squares, const AttackSetLookup& lookup) {
+#ifdef PEXT_DISPATCH
+	if (use_pext) {
+		return lookup.pext_attack_set_table_ptr[pext(occupied_squares, lookup.mask)];
+	}
+#endif
+	return lookup.attack_set_table_ptr[get_lookup_offset(occupied_squares & lookup.mask, lookup.magic, lookup.shift)];
+}
+
 inline uint64_t bishop_attacks(uint64_t occupied_squares, int square) {
-	int index = get_lookup_offset(occupied_squares & bishop_lookup_table[square].mask,
-			bishop_lookup_table[square].magic, bishop_lookup_table[square].shift);
-	return bishop_lookup_table[square].attack_set_table_ptr[index];
+	return lookup_attacks(occupied_squares, bishop_lookup_table.squares[square]);
 }
 
 inline uint64_t rook_attacks(uint64_t occupied_squares, int square) {
-	int index = get_lookup_offset(occupied_squares & rook_lookup_table[square].mask, rook_lookup_table[square].magic,
-			rook_lookup_table[square].shift);
-	return rook_lookup_table[square].attack_set_table_ptr[index];
+	return lookup_attacks(occupied_squares, rook_lookup_table.squares[square]);
 }
 
 inline uint64_t queen_attacks(uint64_t occupied_squares, int square) {
 	return bishop_attacks(occupied_squares, square) | rook_attacks(occupied_squares, square);
 }
 
+/*
+ * true if the cpu has pext and it is faster than the magic multiplication. AMD before Zen 3 runs pext in microcode.
+ */
+bool fast_pext();
+
+/*
+ * selects the pext table (if the cpu has pext) or the magic table, for benchmarks and tests. Not thread safe
+ */
+void set_pext_attacks(bool pext);
+
+/*
+ * the name of the slider attack backend in use, "pext" or "magic"
+ */
+const char* attack_backend();
+
 #endif /* MAGIC_H_ */
@@ -23,20 +23,109 @@
 
 #include "eval.h"
 #include "moves.h"
+#include "fill.h"
 #include "magic.h"
 #include <cstdlib>
 #include <stdlib.h>
 
-uint64_t from_randoms[64];
-uint64_t to_randoms[64];
+/*
+ * the n:th Zobrist random number, splitmix64 of n so the numbers are the same with every compiler and c library
+ */
+constexpr uint64_t zobrist_random(uint64_t n) {
+	uint64_t z = (n + 1) * 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+struct ZobristRandoms {
+	uint64_t pieces[2][6][64];
+	uint64_t meta_info[64];
+};
+
+constexpr ZobristRandoms generate_zobrist_randoms() {
+	ZobristRandoms randoms {};
+	for (int c = 0; c < 2; c++) {
+		for (int piece = 0; piece < 6; piece++) {
+			for (int i = 0; i < 64; i++) {
+				randoms.pieces[c][piece][i] = zobrist_random((c * 6 + piece) * 64 + i);
+			}
+		}
+	}
+	for (int i = 0; i < 64; i++) {
+		randoms.meta_info[i] = zobrist_random(2 * 6 * 64 + i);
+	}
+	return randoms;
+}
 
-int rook_castle_to_squares[64];
-int rook_castle_from_squares[64];
+constexpr ZobristRandoms ZOBRIST_RANDOMS = generate_zobrist_randoms();
+constexpr const uint64_t (&piece_randoms)[2][6][64] = ZOBRIST_RANDOMS.pieces;
+constexpr const uint64_t (&meta_info_randoms)[64] = ZOBRIST_RANDOMS.meta_info;
+constexpr uint64_t black_turn_random = zobrist_random(2 * 6 * 64 + 64);
+
+// the rook squares of a castling by the king to square
+constexpr int rook_castle_to_square(int king_to) {
+	return (king_to & 56) | (king_to & 4 ? 5 : 3);
+}
+
+constexpr int rook_castle_from_square(int king_to) {
+	return (king_to & 56) | (king_to & 4 ? 7 : 0);
+}
 
 // pre-calculated move masks
 
-uint64_t knight_moves[64];
-uint64_t king_moves[64];
+struct MoveMasks {
+	uint64_t knight_moves[64];
+	uint64_t king_moves[64];
+	// the squares between two squares on a line, and the whole line through them
+	uint64_t between_squares[64][64];
+	uint64_t line_squares[64][64];
+};
+
+constexpr MoveMasks generate_move_masks() {
+	const int FILE_STEPS[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+	const int RANK_STEPS[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+	MoveMasks masks {};
+	for (int i = 0; i < 64; i++) {
+		uint64_t b = 1ULL << i;
+		masks.knight_moves[i] = ((b & ~NNW_BORDER) << 15) | ((b & ~NNE_BORDER) << 17) | ((b & ~EEN_BORDER) << 10)
+				| ((b & ~WWN_BORDER) << 6) | ((b & ~EES_BORDER) >> 6) | ((b & ~SSE_BORDER) >> 15)
+				| ((b & ~SSW_BORDER) >> 17) | ((b & ~WWS_BORDER) >> 10);
+		masks.king_moves[i] = ((b & ~NW_BORDER) << 7) | ((b & ~NE_BORDER) << 9) | ((b & ~ROW_8) << 8)
+				| ((b & ~H_FILE) << 1) | ((b & ~A_FILE) >> 1) | ((b & ~ROW_1) >> 8) | ((b & ~SW_BORDER) >> 9)
+				| ((b & ~SE_BORDER) >> 7);
+		for (int dir = 0; dir < 8; dir++) {
+			// the line is the rays in the direction and in the opposite direction
+			uint64_t line = b;
+			for (int opposite = 0; opposite < 2; opposite++) {
+				int file_step = opposite ? -FILE_STEPS[dir] : FILE_STEPS[dir];
+				int rank_step = opposite ? -RANK_STEPS[dir] : RANK_STEPS[dir];
+				for (int file = i % 8 + file_step, rank = i / 8 + rank_step; file >= 0 && file < 8 && rank >= 0 && rank < 8;
+						file += file_step, rank += rank_step) {
+					line |= 1ULL << (rank * 8 + file);
+				}
+			}
+			uint64_t between = 0;
+			for (int file = i % 8 + FILE_STEPS[dir], rank = i / 8 + RANK_STEPS[dir];
+					file >= 0 && file < 8 && rank >= 0 && rank < 8; file += FILE_STEPS[dir], rank += RANK_STEPS[dir]) {
+				masks.between_squares[i][rank * 8 + file] = between;
+				masks.line_squares[i][rank * 8 + file] = line;
+				between |= 1ULL << (rank * 8 + file);
+			}
+		}
+	}
+	return masks;
+}
+
+/*
+ * The tables are generated by the compiler, so they are read only data shared by all processes and there is nothing
+ * to initialize at startup.
+ */
+constexpr MoveMasks MOVE_MASKS = generate_move_masks();
+constexpr const uint64_t (&knight_moves)[64] = MOVE_MASKS.knight_moves;
+constexpr const uint64_t (&king_moves)[64] = MOVE_MASKS.king_moves;
+constexpr const uint64_t (&between_squares)[64][64] = MOVE_MASKS.between_squares;
+constexpr const uint64_t (&line_squares)[64][64] = MOVE_MASKS.line_squares;
 
 uint64_t south_fill(uint64_t l) {
 	l |= l >> 8; // OR 1 row
@@ -52,32 +141,163 @@ uint64_t north_fill(uint64_t l) {
 	return l;
 }
 
-bool make_move(Position& position, Move& move) {
+/**
+ * Zobrist key of the meta info bits, the castling rights and en passant squares
+ */
+inline uint64_t meta_info_key(uint64_t meta_info) {
+	uint64_t key = 0;
+	while (meta_info) {
+		key ^= meta_info_randoms[lsb_to_square(meta_info)];
+		meta_info &= meta_info - 1;
+	}
+	return key;
+}
+
+/**
+ * Zobrist key of the pieces moved, captured and promoted by the move, and the change of side to move
+ */
+inline uint64_t move_key(uint32_t move) {
+	int c = color(move);
+	uint64_t key = black_turn_random ^ piece_randoms[c][piece(move)][from_square(move)];
+	int promotion_piece = promotion_piece(move);
+	key ^= piece_randoms[c][promotion_piece != EMPTY ? promotion_piece : piece(move)][to_square(move)];
+	int captured_piece = captured_piece(move);
+	if (captured_piece == EN_PASSANT) {
+		key ^= piece_randoms[c ^ 1][PAWN][to_square(move) - 8 + (c * 16)];
+	} else if (captured_piece != EMPTY) {
+		key ^= piece_randoms[c ^ 1][captured_piece][to_square(move)];
+	}
+	if (is_castling(move)) {
+		key ^= piece_randoms[c][ROOK][rook_castle_from_square(to_square(move))]
+				^ piece_randoms[c][ROOK][rook_castle_to_square(to_square(move))];
+	}
+	return key;
+}
+
+uint64_t zobrist_key(const Position& position, bool white_turn) {
+	uint64_t key = white_turn ? 0 : black_turn_random;
+	for (int c = 0; c < 2; c++) {
+		for (int piece = 0; piece < 6; piece++) {
+			for (uint64_t b = position.p[c][piece]; b != 0; b = reset_lsb(b)) {
+				key ^= piece_randoms[c][piece][lsb_to_square(b)];
+			}
+		}
+	}
+	return key ^ meta_info_key(current_state(position).meta_info);
+}
+
+#ifdef INCREMENTAL_ATTACKS
+namespace {
+
+/*
+ * the squares attacked by the piece on the square, 0 for an empty square
+ */
+uint64_t square_attacks(const Position& position, int square) {
+	uint64_t b = 1ULL << square;
+	if (!(occupancy(position) & b)) {
+		return 0;
+	}
+	switch (position.board[square]) {
+	case PAWN:
+		return occupancy(position, WHITE) & b ? ((b & ~NW_BORDER) << 7) | ((b & ~NE_BORDER) << 9)
+				: ((b & ~SW_BORDER) >> 9) | ((b & ~SE_BORDER) >> 7);
+	case KNIGHT:
+		return knight_moves[square];
+	case BISHOP:
+		return bishop_attacks(occupancy(position), square);
+	case ROOK:
+		return rook_attacks(occupancy(position), square);
+	case QUEEN:
+		return queen_attacks(occupancy(position), square);
+	default:
+		return king_moves[square];
+	}
+}
+
+/*
+ * updates the attack tables after the pieces on changed_squares are moved, captured or placed. Only the attacks
+ * of the pieces on the changed squares and of the sliders attacking them change
+ */
+void update_attacks(Position& position, uint64_t changed_squares) {
+	uint64_t sliders = position.p[WHITE][BISHOP] | position.p[WHITE][ROOK] | position.p[WHITE][QUEEN]
+			| position.p[BLACK][BISHOP] | position.p[BLACK][ROOK] | position.p[BLACK][QUEEN];
+	uint64_t squares = changed_squares;
+	for (uint64_t b = changed_squares; b; b = reset_lsb(b)) {
+		squares |= position.attacks_to[lsb_to_square(b)] & sliders;
+	}
+	for (; squares; squares = reset_lsb(squares)) {
+		int square = lsb_to_square(squares);
+		uint64_t attacks = square_attacks(position, square);
+		for (uint64_t b = attacks ^ position.attacks_from[square]; b; b = reset_lsb(b)) {
+			position.attacks_to[lsb_to_square(b)] ^= 1ULL << square;
+		}
+		position.attacks_from[square] = attacks;
+	}
+}
+
+/*
+ * the squares the pieces of the move are moved from, to or captured on
+ */
+uint64_t move_squares(uint32_t move) {
+	uint64_t squares = (1ULL << from_square(move)) | (1ULL << to_square(move));
+	if (captured_piece(move) == EN_PASSANT) {
+		squares |= 1ULL << (to_square(move) - 8 + (color(move) * 16));
+	}
+	if (is_castling(move)) {
+		squares |= (1ULL << rook_castle_from_square(to_square(move))) | (1ULL << rook_castle_to_square(to_square(move)));
+	}
+	return squares;
+}
+
+}
+
+void init_attacks(Position& position) {
+	for (int square = 0; square < 64; square++) {
+		position.attacks_from[square] = 0;
+		position.attacks_to[square] = 0;
+	}
+	update_attacks(position, ~0ULL);
+}
+#endif
+
+void make_move(Position& position, Move& move) {
 	position.p[color(move.m)][piece(move.m)] &= ~(1ULL << from_square(move.m));
 	position.p[color(move.m)][piece(move.m)] |= (1ULL << to_square(move.m));
-	uint64_t meta_info = position.meta_info_stack.back();
+	position.color_squares[color(move.m)] ^= (1ULL << from_square(move.m)) | (1ULL << to_square(move.m));
+	position.board[from_square(move.m)] = EMPTY;
+	position.board[to_square(move.m)] = piece(move.m);
+	StateInfo& state = current_state(position);
+	uint64_t meta_info = state.meta_info;
 	int captured_piece = captured_piece(move.m);
 	if (captured_piece != EMPTY) {
 		int captured_color = color(move.m) ^ 1;
 		if (captured_piece != EN_PASSANT) {
 			position.p[captured_color][captured_piece] &= ~(1ULL << to_square(move.m));
+			position.color_squares[captured_color] &= ~(1ULL << to_square(move.m));
 		} else {
 			position.p[captured_color][PAWN] &= ~(1ULL << (to_square(move.m) - 8 + (color(move.m) * 16)));
+			position.color_squares[captured_color] &= ~(1ULL << (to_square(move.m) - 8 + (color(move.m) * 16)));
+			position.board[to_square(move.m) - 8 + (color(move.m) * 16)] = EMPTY;
 		}
 	}
 	int promotion_piece = promotion_piece(move.m);
 	if (promotion_piece != EMPTY) {
 		position.p[color(move.m)][piece(move.m)] &= ~(1ULL << to_square(move.m));
 		position.p[color(move.m)][promotion_piece] |= (1ULL << to_square(move.m));
+		position.board[to_square(move.m)] = promotion_piece;
 	}
-	bool illegal_castling = false;
 	if (is_castling(move.m)) {
-		if (is_illegal_castling_move(move, get_attacked_squares(position, color(move.m)))) {
-			illegal_castling = true;
-		}
-		position.p[color(move.m)][ROOK] &= ~(1ULL << rook_castle_from_squares[to_square(move.m)]);
-		position.p[color(move.m)][ROOK] |= (1ULL << rook_castle_to_squares[to_square(move.m)]);
+		position.p[color(move.m)][ROOK] &= ~(1ULL << rook_castle_from_square(to_square(move.m)));
+		position.p[color(move.m)][ROOK] |= (1ULL << rook_castle_to_square(to_square(move.m)));
+		position.color_squares[color(move.m)] ^= (1ULL << rook_castle_from_square(to_square(move.m)))
+				| (1ULL << rook_castle_to_square(to_square(move.m)));
+		position.board[rook_castle_from_square(to_square(move.m))] = EMPTY;
+		position.board[rook_castle_to_square(to_square(move.m))] = ROOK;
 	}
+	position.occupied_squares = position.color_squares[WHITE] | position.color_squares[BLACK];
+#ifdef INCREMENTAL_ATTACKS
+	update_attacks(position, move_squares(move.m));
+#endif
 	if (piece(move.m) == KING) {
 		meta_info &= ~(ROW_1 << (56 * color(move.m)));
 	}
@@ -97,32 +317,38 @@ bool make_move(Position& position, Move& move) {
 	}
 	meta_info &= clear_en_passant_mask;
 	// set en passant square
-	if (piece(move.m) == PAWN && abs(to_square(move.m) - from_square(move.m)) == 16) {
+	if (piece(move.m) == PAWN && abs((int) to_square(move.m) - (int) from_square(move.m)) == 16) {
 		if (color(move.m) == WHITE) {
 			meta_info |= (1ULL << from_square(move.m)) << 8;
 		} else {
 			meta_info |= (1ULL << from_square(move.m)) >> 8;
 		}
 	}
-	position.meta_info_stack.push_back(meta_info);
-	position.hash_key = position.hash_key ^ move_hash(move.m);
-
-	if (illegal_castling || (get_attacked_squares(position, color(move.m)) & position.p[color(move.m)][KING])) {
-		return false;
-	}
-	return true;
+	state.hash_key = position.hash_key;
+	StateInfo& next_state = position.states[++position.ply];
+	next_state.meta_info = meta_info;
+	next_state.captured_piece = captured_piece;
+	next_state.halfmove_clock = piece(move.m) == PAWN || captured_piece != EMPTY ? 0 : state.halfmove_clock + 1;
+	position.hash_key ^= move_key(move.m) ^ meta_info_key(meta_info ^ state.meta_info);
 }
 
 void unmake_move(Position& position, Move& move) {
 	position.p[color(move.m)][piece(move.m)] |= (1ULL << from_square(move.m));
 	position.p[color(move.m)][piece(move.m)] &= ~(1ULL << to_square(move.m));
+	position.color_squares[color(move.m)] ^= (1ULL << from_square(move.m)) | (1ULL << to_square(move.m));
+	position.board[from_square(move.m)] = piece(move.m);
+	position.board[to_square(move.m)] = EMPTY;
 	int captured_piece = captured_piece(move.m);
 	if (captured_piece != EMPTY) {
 		int captured_color = color(move.m) ^ 1;
 		if (captured_piece != EN_PASSANT) {
 			position.p[captured_color][captured_piece] |= (1ULL << to_square(move.m));
+			position.color_squares[captured_color] |= (1ULL << to_square(move.m));
+			position.board[to_square(move.m)] = captured_piece;
 		} else {
 			position.p[captured_color][PAWN] |= (1ULL << (to_square(move.m) - 8 + (color(move.m) * 16)));
+			position.color_squares[captured_color] |= (1ULL << (to_square(move.m) - 8 + (color(move.m) * 16)));
+			position.board[to_square(move.m) - 8 + (color(move.m) * 16)] = PAWN;
 		}
 	}
 	int promotion_piece = promotion_piece(move.m);
@@ -130,25 +356,28 @@ void unmake_move(Position& position, Move& move) {
 		position.p[color(move.m)][promotion_piece] &= ~(1ULL << to_square(move.m));
 	}
 	if (is_castling(move.m)) {
-		position.p[color(move.m)][ROOK] |= (1ULL << rook_castle_from_squares[to_square(move.m)]);
-		position.p[color(move.m)][ROOK] &= ~(1ULL << rook_castle_to_squares[to_square(move.m)]);
+		position.p[color(move.m)][ROOK] |= (1ULL << rook_castle_from_square(to_square(move.m)));
+		position.p[color(move.m)][ROOK] &= ~(1ULL << rook_castle_to_square(to_square(move.m)));
+		position.color_squares[color(move.m)] ^= (1ULL << rook_castle_from_square(to_square(move.m)))
+				| (1ULL << rook_castle_to_square(to_square(move.m)));
+		position.board[rook_castle_from_square(to_square(move.m))] = ROOK;
+		position.board[rook_castle_to_square(to_square(move.m))] = EMPTY;
 	}
-	// reverse meta-info by poping the last element from the stack
-	position.meta_info_stack.pop_back();
-	position.hash_key = position.hash_key ^ move_hash(move.m);
+	position.occupied_squares = position.color_squares[WHITE] | position.color_squares[BLACK];
+#ifdef INCREMENTAL_ATTACKS
+	update_attacks(position, move_squares(move.m));
+#endif
+	// the meta info and hash key are restored by stepping back to the previous state
+	position.ply--;
+	position.hash_key = current_state(position).hash_key;
 }
 
-
+/*
+ * the squares attacked by a side when occupied_squares are occupied, squares of its own pieces included
+ */
 uint64_t get_attacked_squares(const Position& position, const bool white_turn, uint64_t occupied_squares) {
 	uint64_t attacked_squares = 0;
-	uint64_t black_squares = position.p[BLACK][KING] | position.p[BLACK][PAWN] | position.p[BLACK][KNIGHT]
-			| position.p[BLACK][BISHOP] | position.p[BLACK][ROOK] | position.p[BLACK][QUEEN];
-
-	uint64_t white_squares = position.p[WHITE][KING] | position.p[WHITE][PAWN] | position.p[WHITE][KNIGHT]
-			| position.p[WHITE][BISHOP] | position.p[WHITE][ROOK] | position.p[WHITE][QUEEN];
-
 	int side = white_turn ? WHITE : BLACK;
-	uint64_t side_squares = white_turn ? white_squares : black_squares;
 
 	// knight moves
 	uint64_t knights = position.p[side][KNIGHT];
@@ -157,27 +386,9 @@ uint64_t get_attacked_squares(const Position& position, const bool white_turn, u
 		attacked_squares |= knight_moves[from];
 		knights = reset_lsb(knights);
 	}
-	// bishop moves
-	uint64_t bishops = position.p[side][BISHOP];
-	while (bishops) {
-		int from = lsb_to_square(bishops);
-		attacked_squares |= bishop_attacks(occupied_squares, from);
-		bishops = reset_lsb(bishops);
-	}
-	// rook moves
-	uint64_t rooks = position.p[side][ROOK];
-	while (rooks) {
-		int from = lsb_to_square(rooks);
-		attacked_squares |= rook_attacks(occupied_squares, from);
-		rooks = reset_lsb(rooks);
-	}
-	// queen moves
-	uint64_t queens = position.p[side][QUEEN];
-	while (queens) {
-		int from = lsb_to_square(queens);
-		attacked_squares |= queen_attacks(occupied_squares, from);
-		queens = reset_lsb(queens);
-	}
+	// bishop, rook and queen moves, all at once
+	attacked_squares |= slider_attack_map(position.p[side][BISHOP] | position.p[side][QUEEN],
+			position.p[side][ROOK] | position.p[side][QUEEN], occupied_squares);
 	// king moves
 	uint64_t king = position.p[side][KING];
 	int from = lsb_to_square(king);
@@ -193,7 +404,6 @@ uint64_t get_attacked_squares(const Position& position, const bool white_turn, u
 		attacked_squares |= (position.p[BLACK][PAWN] & ~SE_BORDER) >> 7;
 	}
 
-	attacked_squares &= ~side_squares;
 	return attacked_squares;
 }
 
@@ -250,10 +460,11 @@ int find_and_reset_least_valuable_piece(SEEInfo& see_info, const int& side,const
 }
 
 int see(const Position& position, const Move& capturing_move) {
-	if (captured_piece(capturing_move.m) > KING) {
+	if (captured_piece(capturing_move.m) == EN_PASSANT) {
 		return 0; // special move - ignore
 	}
-	int captured_piece_value = PIECE_VALUES[captured_piece(capturing_move.m)];
+	// a quiet move captures nothing, the exchange starts when the opponent captures the moved piece
+	int captured_piece_value = captured_piece(capturing_move.m) == EMPTY ? 0 : PIECE_VALUES[captured_piece(capturing_move.m)];
 	int capturing_piece_value = PIECE_VALUES[piece(capturing_move.m)];
 	if (captured_piece_value >= capturing_piece_value) {
 		return captured_piece_value - capturing_piece_value;
@@ -262,23 +473,9 @@ int see(const Position& position, const Move& capturing_move) {
 
 	uint64_t bb_square = 1L << square;
 
-	uint64_t black_squares = position.p[BLACK][KING]
-			| position.p[BLACK][PAWN]
-			| position.p[BLACK][KNIGHT]
-			| position.p[BLACK][BISHOP]
-			| position.p[BLACK][ROOK]
-			| position.p[BLACK][QUEEN];
-
-	uint64_t white_squares = position.p[WHITE][KING]
-			| position.p[WHITE][PAWN]
-			| position.p[WHITE][KNIGHT]
-			| position.p[WHITE][BISHOP]
-			| position.p[WHITE][ROOK]
-			| position.p[WHITE][QUEEN];
-
 	SEEInfo see_info;
 
-	see_info.occupied_squares = black_squares | white_squares;
+	see_info.occupied_squares = occupancy(position);
 
 	// all pieces attacking the square that are independent of x-rays
 	see_info.attacking_pieces[WHITE][PAWN] |= position.p[WHITE][PAWN] & ((bb_square & ~SW_BORDER) >> 9);
@@ -315,8 +512,11 @@ int see(const Position& position, const Move& capturing_move) {
 		int least_valueable_attacker_value = find_and_reset_least_valuable_piece(see_info, move_side,
 				square);
 		if (least_valueable_attacker_value) {
-			// in check after capture?
-			if (get_attacked_squares(position, move_side != WHITE, see_info.occupied_squares) & position.p[move_side][KING]) {
+			// in check after capture? The pieces that have captured before are gone and a capturing king is on square
+			int king_square = least_valueable_attacker_value == PIECE_VALUES[KING] ? square
+					: lsb_to_square(position.p[move_side][KING]);
+			if (attackers_to(position, king_square, see_info.occupied_squares) & see_info.occupied_squares & ~bb_square
+					& occupancy(position, move_side ^ 1)) {
 				//illegal move
 				break;
 			}
@@ -356,469 +556,516 @@ inline void add_capture_move(const int& from, const int& to, const int& color, c
 		move.sort_score = see(position, move);
 	}
 	move.sort_score += 1000000;
-	moves.push_front(move);
+	moves.push_back(move);
 }
 
 inline void add_castle_move(int from, int to, int color, MoveList& moves) {
 	Move move;
 	move.m = to_castle_move(from, to, color);
 	move.sort_score = 1;
-	moves.push_front(move);
+	moves.push_back(move);
 }
 
 uint64_t get_attacked_squares(const Position& position, const bool white_turn) {
-	uint64_t black_squares = position.p[BLACK][KING] | position.p[BLACK][PAWN] | position.p[BLACK][KNIGHT]
-			| position.p[BLACK][BISHOP] | position.p[BLACK][ROOK] | position.p[BLACK][QUEEN];
-
-	uint64_t white_squares = position.p[WHITE][KING] | position.p[WHITE][PAWN] | position.p[WHITE][KNIGHT]
-			| position.p[WHITE][BISHOP] | position.p[WHITE][ROOK] | position.p[WHITE][QUEEN];
-
-	uint64_t occupied_squares = black_squares | white_squares;
-
-	return get_attacked_squares(position, white_turn, occupied_squares);
+	return get_attacked_squares(position, white_turn, occupancy(position)) & ~occupancy(position, white_turn ? WHITE : BLACK);
 }
 
-MoveList get_captures(const Position& position, const bool white_turn) {
-	MoveList moves;
-	if ((position.p[WHITE][KING] == 0) || (position.p[BLACK][KING]) == 0) {
-		return moves;
-	}
-	uint64_t black_squares = position.p[BLACK][KING] | position.p[BLACK][PAWN] | position.p[BLACK][KNIGHT]
-			| position.p[BLACK][BISHOP] | position.p[BLACK][ROOK] | position.p[BLACK][QUEEN];
-
-	uint64_t white_squares = position.p[WHITE][KING] | position.p[WHITE][PAWN] | position.p[WHITE][KNIGHT]
-			| position.p[WHITE][BISHOP] | position.p[WHITE][ROOK] | position.p[WHITE][QUEEN];
-
-	uint64_t occupied_squares = black_squares | white_squares;
-	uint64_t meta_info = position.meta_info_stack.back();
+uint64_t attackers_to(const Position& position, int square, uint64_t occupied_squares) {
+	uint64_t b = 1ULL << square;
+	// the squares the white and black pawns attack the square from
+	uint64_t white_pawn_squares = ((b & ~SW_BORDER) >> 9) | ((b & ~SE_BORDER) >> 7);
+	uint64_t black_pawn_squares = ((b & ~NW_BORDER) << 7) | ((b & ~NE_BORDER) << 9);
+	return (white_pawn_squares & position.p[WHITE][PAWN]) | (black_pawn_squares & position.p[BLACK][PAWN])
+			| (knight_moves[square] & (position.p[WHITE][KNIGHT] | position.p[BLACK][KNIGHT]))
+			| (king_moves[square] & (position.p[WHITE][KING] | position.p[BLACK][KING]))
+			| (bishop_attacks(occupied_squares, square) & (position.p[WHITE][BISHOP] | position.p[BLACK][BISHOP]
+					| position.p[WHITE][QUEEN] | position.p[BLACK][QUEEN]))
+			| (rook_attacks(occupied_squares, square) & (position.p[WHITE][ROOK] | position.p[BLACK][ROOK]
+					| position.p[WHITE][QUEEN] | position.p[BLACK][QUEEN]));
+}
 
+bool is_in_check(const Position& position, const bool white_turn) {
 	int side = white_turn ? WHITE : BLACK;
-	int opponent = 1 - side;
-
-	uint64_t opponent_squares = white_turn ? black_squares : white_squares;
+	return attackers_to(position, lsb_to_square(position.p[side][KING])) & occupancy(position, side ^ 1);
+}
 
-	// knight moves
-	uint64_t knights = position.p[side][KNIGHT];
-	while (knights) {
-		int from = lsb_to_square(knights);
-		uint64_t to_squares = knight_moves[from] & opponent_squares;
-		while (to_squares) {
-			int to = lsb_to_square(to_squares);
-			uint64_t lsb = lsb(to_squares);
-			add_capture_move(from, to, side, KNIGHT, piece_at_board(position, lsb, opponent), moves, EMPTY, position);
-			to_squares -= lsb;
-		}
-		knights = reset_lsb(knights);
-	}
-	// bishop moves
-	uint64_t bishops = position.p[side][BISHOP];
-	while (bishops) {
-		int from = lsb_to_square(bishops);
-		uint64_t to_squares = bishop_attacks(occupied_squares, from) & opponent_squares;
-		while (to_squares) {
-			int to = lsb_to_square(to_squares);
-			uint64_t lsb = lsb(to_squares);
-			add_capture_move(from, to, side, BISHOP, piece_at_board(position, lsb, opponent), moves, EMPTY, position);
-			to_squares -= lsb;
-		}
-		bishops = reset_lsb(bishops);
-	}
-	// rook moves
-	uint64_t rooks = position.p[side][ROOK];
-	while (rooks) {
-		int from = lsb_to_square(rooks);
-		uint64_t to_squares = rook_attacks(occupied_squares, from) & opponent_squares;
-		while (to_squares) {
-			int to = lsb_to_square(to_squares);
-			uint64_t lsb = lsb(to_squares);
-			add_capture_move(from, to, side, ROOK, piece_at_board(position, lsb, opponent), moves, EMPTY, position);
-			to_squares -= lsb;
-		}
-		rooks = reset_lsb(rooks);
-	}
-	// queen moves
-	uint64_t queens = position.p[side][QUEEN];
-	while (queens) {
-		int from = lsb_to_square(queens);
-		uint64_t to_squares = queen_attacks(occupied_squares, from) & opponent_squares;
-		while (to_squares) {
-			int to = lsb_to_square(to_squares);
-			uint64_t lsb = lsb(to_squares);
-			add_capture_move(from, to, side, QUEEN, piece_at_board(position, lsb, opponent), moves, EMPTY, position);
-			to_squares -= lsb;
+/*
+ * the pieces, of both sides, that are alone between the king square and a slider of slider_side
+ */
+uint64_t slider_blockers(const Position& position, int king_square, int slider_side) {
+	uint64_t occupied_squares = occupancy(position);
+	uint64_t snipers = (bishop_attacks(0, king_square) & (position.p[slider_side][BISHOP] | position.p[slider_side][QUEEN]))
+			| (rook_attacks(0, king_square) & (position.p[slider_side][ROOK] | position.p[slider_side][QUEEN]));
+	uint64_t blockers = 0;
+	while (snipers) {
+		uint64_t between = between_squares[king_square][lsb_to_square(snipers)] & occupied_squares;
+		if (between && !reset_lsb(between)) {
+			blockers |= between;
 		}
-		queens = reset_lsb(queens);
+		snipers = reset_lsb(snipers);
 	}
+	return blockers;
+}
 
-	// king moves
-	uint64_t king = position.p[side][KING];
-	int from = lsb_to_square(king);
-	uint64_t to_squares = king_moves[from] & opponent_squares;
-	while (to_squares) {
-		int to = lsb_to_square(to_squares);
-		uint64_t lsb = lsb(to_squares);
-		add_capture_move(from, to, side, KING, piece_at_board(position, lsb, opponent), moves, EMPTY, position);
-		to_squares -= lsb;
-	}
+CheckInfo check_info(const Position& position, const bool white_turn) {
+	CheckInfo info;
+	int side = white_turn ? WHITE : BLACK;
+	int opponent = side ^ 1;
+	uint64_t occupied_squares = occupancy(position);
+	int king_square = lsb_to_square(position.p[side][KING]);
+	info.king_square = king_square;
+	info.checkers = attackers_to(position, king_square) & occupancy(position, opponent);
+	info.pinned = slider_blockers(position, king_square, opponent) & occupancy(position, side);
+
+	int opponent_king_square = lsb_to_square(position.p[opponent][KING]);
+	uint64_t opponent_king = position.p[opponent][KING];
+	info.opponent_king_square = opponent_king_square;
+	info.check_squares[PAWN] = white_turn ? ((opponent_king & ~SW_BORDER) >> 9) | ((opponent_king & ~SE_BORDER) >> 7)
+			: ((opponent_king & ~NW_BORDER) << 7) | ((opponent_king & ~NE_BORDER) << 9);
+	info.check_squares[KNIGHT] = knight_moves[opponent_king_square];
+	info.check_squares[BISHOP] = bishop_attacks(occupied_squares, opponent_king_square);
+	info.check_squares[ROOK] = rook_attacks(occupied_squares, opponent_king_square);
+	info.check_squares[QUEEN] = info.check_squares[BISHOP] | info.check_squares[ROOK];
+	info.discovered_checks = slider_blockers(position, opponent_king_square, side) & occupancy(position, side);
+	return info;
+}
 
-	if (white_turn) {
-		// white pawn captures
-		uint64_t capture_squares_w = ((position.p[WHITE][PAWN] & ~NW_BORDER) << 7) & (black_squares | (meta_info & ROW_6));
-		while (capture_squares_w) {
-			int to = lsb_to_square(capture_squares_w);
-			int from = to - 7;
-			if (to <= 55) {
-				add_capture_move(from, to, WHITE, PAWN, piece_at_square(position, to, BLACK), moves, EMPTY, position);
-			} else {
-				add_capture_move(from, to, WHITE, PAWN, piece_at_square(position, to, BLACK), moves, QUEEN, position);
-				add_capture_move(from, to, WHITE, PAWN, piece_at_square(position, to, BLACK), moves, ROOK, position);
-				add_capture_move(from, to, WHITE, PAWN, piece_at_square(position, to, BLACK), moves, BISHOP, position);
-				add_capture_move(from, to, WHITE, PAWN, piece_at_square(position, to, BLACK), moves, KNIGHT, position);
-			}
-			capture_squares_w = reset_lsb(capture_squares_w);
-		}
-		uint64_t capture_squares_e = ((position.p[WHITE][PAWN] & ~NE_BORDER) << 9) & (black_squares | (meta_info & ROW_6));
-		while (capture_squares_e) {
-			int to = lsb_to_square(capture_squares_e);
-			int from = to - 9;
-			if (to <= 55) {
-				add_capture_move(from, to, WHITE, PAWN, piece_at_square(position, to, BLACK), moves, EMPTY, position);
-			} else {
-				add_capture_move(from, to, WHITE, PAWN, piece_at_square(position, to, BLACK), moves, QUEEN, position);
-				add_capture_move(from, to, WHITE, PAWN, piece_at_square(position, to, BLACK), moves, ROOK, position);
-				add_capture_move(from, to, WHITE, PAWN, piece_at_square(position, to, BLACK), moves, BISHOP, position);
-				add_capture_move(from, to, WHITE, PAWN, piece_at_square(position, to, BLACK), moves, KNIGHT, position);
+bool is_legal(const Position& position, const CheckInfo& info, uint32_t move) {
+	int from = from_square(move);
+	uint64_t to_square = 1ULL << to_square(move);
+	if (piece(move) == KING) {
+		int opponent = color(move) ^ 1;
+		if (is_castling(move)) {
+			// the king may not castle out of, through or into check
+			int step = (int) to_square(move) > from ? 1 : -1;
+			for (int square = from; square != (int) to_square(move) + step; square += step) {
+				if (attackers_to(position, square) & occupancy(position, opponent)) {
+					return false;
+				}
 			}
-			capture_squares_e = reset_lsb(capture_squares_e);
+			return true;
 		}
-	} else {
-		// black pawn captures
-		uint64_t capture_squares_w = ((position.p[BLACK][PAWN] & ~SW_BORDER) >> 9) & (white_squares | (meta_info & ROW_3));
-		while (capture_squares_w) {
-			int to = lsb_to_square(capture_squares_w);
-			int from = to + 9;
-			if (to >= 8) {
-				add_capture_move(from, to, BLACK, PAWN, piece_at_square(position, to, WHITE), moves, EMPTY, position);
-			} else {
-				add_capture_move(from, to, BLACK, PAWN, piece_at_square(position, to, WHITE), moves, QUEEN, position);
-				add_capture_move(from, to, BLACK, PAWN, piece_at_square(position, to, WHITE), moves, ROOK, position);
-				add_capture_move(from, to, BLACK, PAWN, piece_at_square(position, to, WHITE), moves, BISHOP, position);
-				add_capture_move(from, to, BLACK, PAWN, piece_at_square(position, to, WHITE), moves, KNIGHT, position);
-			}
-			capture_squares_w = reset_lsb(capture_squares_w);
-		}
-		uint64_t capture_squares_e = ((position.p[BLACK][PAWN] & ~SE_BORDER) >> 7) & (white_squares | (meta_info & ROW_3));
-		while (capture_squares_e) {
-			int to = lsb_to_square(capture_squares_e);
-			int from = to + 7;
-			if (to >= 8) {
-				add_capture_move(from, to, BLACK, PAWN, piece_at_square(position, to, WHITE), moves, EMPTY, position);
-			} else {
-				add_capture_move(from, to, BLACK, PAWN, piece_at_square(position, to, WHITE), moves, QUEEN, position);
-				add_capture_move(from, to, BLACK, PAWN, piece_at_square(position, to, WHITE), moves, ROOK, position);
-				add_capture_move(from, to, BLACK, PAWN, piece_at_square(position, to, WHITE), moves, BISHOP, position);
-				add_capture_move(from, to, BLACK, PAWN, piece_at_square(position, to, WHITE), moves, KNIGHT, position);
-			}
-			capture_squares_e = reset_lsb(capture_squares_e);
+		// the king does not block the attacks of sliders on squares behind it
+		return !(attackers_to(position, to_square(move), occupancy(position) ^ (1ULL << from))
+				& occupancy(position, opponent));
+	}
+	int captured_piece = captured_piece(move);
+	if (info.checkers) {
+		if (reset_lsb(info.checkers)) {
+			// double check, only the king can move
+			return false;
+		}
+		uint64_t evasion_squares = info.checkers | between_squares[info.king_square][lsb_to_square(info.checkers)];
+		if (captured_piece != EN_PASSANT && !(to_square & evasion_squares)) {
+			return false;
 		}
 	}
-	return moves;
+	if (captured_piece == EN_PASSANT) {
+		// both pawns leave their squares, look for attacks on the king through them
+		int side = color(move);
+		int opponent = side ^ 1;
+		uint64_t captured_square = 1ULL << (to_square(move) - 8 + (side * 16));
+		uint64_t occupied_squares = (occupancy(position) ^ (1ULL << from) ^ captured_square) | to_square;
+		uint64_t attackers = (bishop_attacks(occupied_squares, info.king_square)
+				& (position.p[opponent][BISHOP] | position.p[opponent][QUEEN]))
+				| (rook_attacks(occupied_squares, info.king_square) & (position.p[opponent][ROOK] | position.p[opponent][QUEEN]))
+				| (info.checkers & (position.p[opponent][KNIGHT] | position.p[opponent][PAWN]) & ~captured_square);
+		return !attackers;
+	}
+	// a pinned piece may only move along the line to the king
+	return !(info.pinned & (1ULL << from)) || (line_squares[info.king_square][from] & to_square);
 }
 
-MoveList get_moves(const Position& position, const bool white_turn) {
-	MoveList moves;
-	if ((position.p[WHITE][KING] == 0) || (position.p[BLACK][KING]) == 0) {
-		return moves;
-	}
-	uint64_t black_squares = position.p[BLACK][KING] | position.p[BLACK][PAWN] | position.p[BLACK][KNIGHT]
-			| position.p[BLACK][BISHOP] | position.p[BLACK][ROOK] | position.p[BLACK][QUEEN];
+namespace {
 
-	uint64_t white_squares = position.p[WHITE][KING] | position.p[WHITE][PAWN] | position.p[WHITE][KNIGHT]
-			| position.p[WHITE][BISHOP] | position.p[WHITE][ROOK] | position.p[WHITE][QUEEN];
+/*
+ * the kinds of moves made by generate
+ */
+enum GenType {
+	CAPTURES, // captures, promotions by capture included
+	QUIETS, // moves that are not captures, quiet promotions and castling included
+	EVASIONS, // the legal moves when in check
+	QUIET_CHECKS // quiet moves that give check, promotions and castling excluded
+};
 
-	uint64_t occupied_squares = black_squares | white_squares;
-	uint64_t meta_info = position.meta_info_stack.back();
+template<int side>
+inline uint64_t pawn_push(uint64_t pawns) {
+	return side == WHITE ? pawns << 8 : pawns >> 8;
+}
 
-	int side = white_turn ? WHITE : BLACK;
-	int opponent = 1 - side;
+template<int side>
+inline uint64_t pawn_attacks_west(uint64_t pawns) {
+	return side == WHITE ? (pawns & ~NW_BORDER) << 7 : (pawns & ~SW_BORDER) >> 9;
+}
 
-	uint64_t side_squares = white_turn ? white_squares : black_squares;
-	uint64_t opponent_squares = white_turn ? black_squares : white_squares;
+template<int side>
+inline uint64_t pawn_attacks_east(uint64_t pawns) {
+	return side == WHITE ? (pawns & ~NE_BORDER) << 9 : (pawns & ~SE_BORDER) >> 7;
+}
 
-	//knight moves
-	uint64_t knights = position.p[side][KNIGHT];
-	while (knights) {
-		int from = lsb_to_square(knights);
-		uint64_t to_squares = knight_moves[from] & ~side_squares;
-		while (to_squares) {
-			int to = lsb_to_square(to_squares);
-			uint64_t lsb = lsb(to_squares);
-			if (lsb & opponent_squares) {
-				add_capture_move(from, to, side, KNIGHT, piece_at_board(position, lsb, opponent), moves, EMPTY, position);
-			} else {
-				add_quite_move(from, to, side, KNIGHT, moves, EMPTY);
-			}
-			to_squares -= lsb;
-		}
-		knights = reset_lsb(knights);
-	}
-	uint64_t bishops = position.p[side][BISHOP];
-	while (bishops) {
-		int from = lsb_to_square(bishops);
-		uint64_t to_squares = bishop_attacks(occupied_squares, from) & ~side_squares;
-		while (to_squares) {
-			int to = lsb_to_square(to_squares);
-			uint64_t lsb = lsb(to_squares);
-			if (lsb & opponent_squares) {
-				add_capture_move(from, to, side, BISHOP, piece_at_board(position, lsb, opponent), moves, EMPTY, position);
-			} else {
-				add_quite_move(from, to, side, BISHOP, moves, EMPTY);
-			}
-			to_squares -= lsb;
-		}
-		bishops = reset_lsb(bishops);
+template<int piece>
+inline uint64_t piece_attacks(int square, uint64_t occupied_squares) {
+	return piece == KNIGHT ? knight_moves[square] : piece == BISHOP ? bishop_attacks(occupied_squares, square)
+			: piece == ROOK ? rook_attacks(occupied_squares, square)
+			: piece == QUEEN ? queen_attacks(occupied_squares, square) : king_moves[square];
+}
+
+inline uint64_t piece_attacks(int piece, int square, uint64_t occupied_squares) {
+	switch (piece) {
+	case KNIGHT:
+		return piece_attacks<KNIGHT>(square, occupied_squares);
+	case BISHOP:
+		return piece_attacks<BISHOP>(square, occupied_squares);
+	case ROOK:
+		return piece_attacks<ROOK>(square, occupied_squares);
+	case QUEEN:
+		return piece_attacks<QUEEN>(square, occupied_squares);
+	default:
+		return piece_attacks<KING>(square, occupied_squares);
 	}
-	// rook moves
-	uint64_t rooks = position.p[side][ROOK];
-	while (rooks) {
-		int from = lsb_to_square(rooks);
-		uint64_t to_squares = rook_attacks(occupied_squares, from) & ~side_squares;
-		while (to_squares) {
-			int to = lsb_to_square(to_squares);
-			uint64_t lsb = lsb(to_squares);
-			if (lsb & opponent_squares) {
-				add_capture_move(from, to, side, ROOK, piece_at_board(position, lsb, opponent), moves, EMPTY, position);
-			} else {
-				add_quite_move(from, to, side, ROOK, moves, EMPTY);
-			}
-			to_squares -= lsb;
+}
+
+/*
+ * only the evasions mix captures and quiet moves
+ */
+template<int side, GenType type>
+inline void add_moves(const Position& position, int from, int piece, uint64_t to_squares, MoveList& moves) {
+	for (; to_squares; to_squares = reset_lsb(to_squares)) {
+		int to = lsb_to_square(to_squares);
+		if (type == CAPTURES || (type == EVASIONS && (lsb(to_squares) & occupancy(position, side ^ 1)))) {
+			add_capture_move(from, to, side, piece, piece_at_square(position, to, side ^ 1), moves, EMPTY, position);
+		} else {
+			add_quite_move(from, to, side, piece, moves, EMPTY);
 		}
-		rooks = reset_lsb(rooks);
 	}
-	// queen moves
-	uint64_t queens = position.p[side][QUEEN];
-	while (queens) {
-		int from = lsb_to_square(queens);
-		uint64_t to_squares = queen_attacks(occupied_squares, from) & ~side_squares;
-		while (to_squares) {
-			int to = lsb_to_square(to_squares);
-			uint64_t lsb = lsb(to_squares);
-			if (lsb & opponent_squares) {
-				add_capture_move(from, to, side, QUEEN, piece_at_board(position, lsb, opponent), moves, EMPTY, position);
-			} else {
-				add_quite_move(from, to, side, QUEEN, moves, EMPTY);
-			}
-			to_squares -= lsb;
-		}
-		queens = reset_lsb(queens);
+}
+
+template<int side, GenType type, int piece>
+inline void generate_piece_moves(const Position& position, uint64_t pieces, uint64_t targets, MoveList& moves) {
+	for (; pieces; pieces = reset_lsb(pieces)) {
+		int from = lsb_to_square(pieces);
+		add_moves<side, type>(position, from, piece, piece_attacks<piece>(from, occupancy(position)) & targets, moves);
 	}
+}
 
-	if (white_turn) {
-		// white pawn push
-		uint64_t to_squares = (position.p[WHITE][PAWN] & ~ROW_8) << 8;
-		to_squares = to_squares & ~occupied_squares;
-		uint64_t two_step_squares = (to_squares & ROW_3) << 8 & ~occupied_squares;
-		while (to_squares) {
+/*
+ * the pawn moves to targets. For captures and evasions the en passant square is a target as well,
+ * and en passant evasions are tested with info
+ */
+template<int side, GenType type>
+void generate_pawn_moves(const Position& position, uint64_t pawns, uint64_t targets, const CheckInfo& info,
+		MoveList& moves) {
+	const int forward = side == WHITE ? 8 : -8;
+	const uint64_t third_row = side == WHITE ? ROW_3 : ROW_6;
+	const uint64_t last_row = side == WHITE ? ROW_8 : ROW_1;
+	if (type != CAPTURES) {
+		uint64_t empty_squares = ~occupancy(position);
+		uint64_t to_squares = pawn_push<side>(pawns) & empty_squares;
+		uint64_t two_step_squares = pawn_push<side>(to_squares & third_row) & empty_squares & targets;
+		to_squares &= type == QUIET_CHECKS ? targets & ~last_row : targets;
+		for (; to_squares; to_squares = reset_lsb(to_squares)) {
 			int to = lsb_to_square(to_squares);
-			int from = to - 8;
-			if (to <= 55) {
-				add_quite_move(from, to, WHITE, PAWN, moves, EMPTY);
+			if (!(lsb(to_squares) & last_row)) {
+				add_quite_move(to - forward, to, side, PAWN, moves, EMPTY);
 			} else {
-				add_quite_move(from, to, WHITE, PAWN, moves, QUEEN);
-				add_quite_move(from, to, WHITE, PAWN, moves, ROOK);
-				add_quite_move(from, to, WHITE, PAWN, moves, BISHOP);
-				add_quite_move(from, to, WHITE, PAWN, moves, KNIGHT);
+				add_quite_move(to - forward, to, side, PAWN, moves, QUEEN);
+				add_quite_move(to - forward, to, side, PAWN, moves, ROOK);
+				add_quite_move(to - forward, to, side, PAWN, moves, BISHOP);
+				add_quite_move(to - forward, to, side, PAWN, moves, KNIGHT);
 			}
-			to_squares = reset_lsb(to_squares);
 		}
-		while (two_step_squares) {
+		for (; two_step_squares; two_step_squares = reset_lsb(two_step_squares)) {
 			int to = lsb_to_square(two_step_squares);
-			int from = to - 16;
-			add_quite_move(from, to, WHITE, PAWN, moves, EMPTY);
-			two_step_squares = reset_lsb(two_step_squares);
-		}
-		// white pawn captures
-		uint64_t capture_squares_w = ((position.p[WHITE][PAWN] & ~NW_BORDER) << 7) & (black_squares | (meta_info & ROW_6));
-		while (capture_squares_w) {
-			int to = lsb_to_square(capture_squares_w);
-			int from = to - 7;
-			if (to <= 55) {
-				add_capture_move(from, to, WHITE, PAWN, piece_at_square(position, to, BLACK), moves, EMPTY, position);
-			} else {
-				add_capture_move(from, to, WHITE, PAWN, piece_at_square(position, to, BLACK), moves, QUEEN, position);
-				add_capture_move(from, to, WHITE, PAWN, piece_at_square(position, to, BLACK), moves, ROOK, position);
-				add_capture_move(from, to, WHITE, PAWN, piece_at_square(position, to, BLACK), moves, BISHOP, position);
-				add_capture_move(from, to, WHITE, PAWN, piece_at_square(position, to, BLACK), moves, KNIGHT, position);
-			}
-			capture_squares_w = reset_lsb(capture_squares_w);
-		}
-		uint64_t capture_squares_e = ((position.p[WHITE][PAWN] & ~NE_BORDER) << 9) & (black_squares | (meta_info & ROW_6));
-		while (capture_squares_e) {
-			int to = lsb_to_square(capture_squares_e);
-			int from = to - 9;
-			if (to <= 55) {
-				add_capture_move(from, to, WHITE, PAWN, piece_at_square(position, to, BLACK), moves, EMPTY, position);
-			} else {
-				add_capture_move(from, to, WHITE, PAWN, piece_at_square(position, to, BLACK), moves, QUEEN, position);
-				add_capture_move(from, to, WHITE, PAWN, piece_at_square(position, to, BLACK), moves, ROOK, position);
-				add_capture_move(from, to, WHITE, PAWN, piece_at_square(position, to, BLACK), moves, BISHOP, position);
-				add_capture_move(from, to, WHITE, PAWN, piece_at_square(position, to, BLACK), moves, KNIGHT, position);
-			}
-			capture_squares_e = reset_lsb(capture_squares_e);
+			add_quite_move(to - 2 * forward, to, side, PAWN, moves, EMPTY);
 		}
-		// white king moves
-		uint64_t king = position.p[WHITE][KING];
-		int from = lsb_to_square(king);
-		to_squares = king_moves[from] & ~white_squares;
-		while (to_squares) {
-			int to = lsb_to_square(to_squares);
-			uint64_t lsb = lsb(to_squares);
-			if (lsb & black_squares) {
-				add_capture_move(from, to, WHITE, KING, piece_at_board(position, lsb, BLACK), moves, EMPTY, position);
-			} else {
-				add_quite_move(from, to, WHITE, KING, moves, EMPTY);
+	}
+	if (type == CAPTURES || type == EVASIONS) {
+		uint64_t capture_squares = (targets & occupancy(position, side ^ 1))
+				| (current_state(position).meta_info & (side == WHITE ? ROW_6 : ROW_3));
+		for (int west = 1; west >= 0; west--) {
+			uint64_t to_squares = (west ? pawn_attacks_west<side>(pawns) : pawn_attacks_east<side>(pawns)) & capture_squares;
+			int from_offset = west ? (side == WHITE ? 7 : -9) : (side == WHITE ? 9 : -7);
+			for (; to_squares; to_squares = reset_lsb(to_squares)) {
+				int to = lsb_to_square(to_squares);
+				int from = to - from_offset;
+				int captured_piece = piece_at_square(position, to, side ^ 1);
+				if (type == EVASIONS && captured_piece == EN_PASSANT
+						&& !is_legal(position, info, to_capture_move(from, to, PAWN, EN_PASSANT, side, EMPTY))) {
+					continue;
+				}
+				if (!(lsb(to_squares) & last_row)) {
+					add_capture_move(from, to, side, PAWN, captured_piece, moves, EMPTY, position);
+				} else {
+					add_capture_move(from, to, side, PAWN, captured_piece, moves, QUEEN, position);
+					add_capture_move(from, to, side, PAWN, captured_piece, moves, ROOK, position);
+					add_capture_move(from, to, side, PAWN, captured_piece, moves, BISHOP, position);
+					add_capture_move(from, to, side, PAWN, captured_piece, moves, KNIGHT, position);
+				}
 			}
-			to_squares -= lsb;
 		}
-		// castling
+	}
+}
+
+template<int side>
+void generate_castling_moves(const Position& position, MoveList& moves) {
+	uint64_t meta_info = current_state(position).meta_info;
+	uint64_t occupied_squares = occupancy(position);
+	if (side == WHITE) {
 		if ((meta_info & G1) && !(occupied_squares & white_king_side_castle_squares) && (position.p[WHITE][ROOK] & H1)) {
-			add_castle_move(from, lsb_to_square(G1), WHITE, moves);
+			add_castle_move(lsb_to_square(E1), lsb_to_square(G1), WHITE, moves);
 		}
 		if ((meta_info & C1) && !(occupied_squares & white_queen_side_castle_squares) && (position.p[WHITE][ROOK] & A1)) {
-			add_castle_move(from, lsb_to_square(C1), WHITE, moves);
+			add_castle_move(lsb_to_square(E1), lsb_to_square(C1), WHITE, moves);
 		}
 	} else {
-		// black pawn push
-		uint64_t to_squares = (position.p[BLACK][PAWN] & ~ROW_1) >> 8;
-		to_squares = to_squares & ~occupied_squares;
-		uint64_t two_step_squares = ((to_squares & ROW_6) >> 8) & ~occupied_squares;
-		while (to_squares) {
-			int to = lsb_to_square(to_squares);
-			int from = to + 8;
-			if (to >= 8) {
-				add_quite_move(from, to, BLACK, PAWN, moves, EMPTY);
-			} else {
-				add_quite_move(from, to, BLACK, PAWN, moves, QUEEN);
-				add_quite_move(from, to, BLACK, PAWN, moves, ROOK);
-				add_quite_move(from, to, BLACK, PAWN, moves, BISHOP);
-				add_quite_move(from, to, BLACK, PAWN, moves, KNIGHT);
-			}
-			to_squares = reset_lsb(to_squares);
+		if ((meta_info & G8) && !(occupied_squares & black_king_side_castle_squares) && (position.p[BLACK][ROOK] & H8)) {
+			add_castle_move(lsb_to_square(E8), lsb_to_square(G8), BLACK, moves);
 		}
-		while (two_step_squares) {
-			int to = lsb_to_square(two_step_squares);
-			int from = to + 16;
-			add_quite_move(from, to, BLACK, PAWN, moves, EMPTY);
-			two_step_squares = reset_lsb(two_step_squares);
+		if ((meta_info & C8) && !(occupied_squares & black_queen_side_castle_squares) && (position.p[BLACK][ROOK] & A8)) {
+			add_castle_move(lsb_to_square(E8), lsb_to_square(C8), BLACK, moves);
 		}
-		// black pawn captures
-		uint64_t capture_squares_w = ((position.p[BLACK][PAWN] & ~SW_BORDER) >> 9) & (white_squares | (meta_info & ROW_3));
-		while (capture_squares_w) {
-			int to = lsb_to_square(capture_squares_w);
-			int from = to + 9;
-			if (to >= 8) {
-				add_capture_move(from, to, BLACK, PAWN, piece_at_square(position, to, WHITE), moves, EMPTY, position);
-			} else {
-				add_capture_move(from, to, BLACK, PAWN, piece_at_square(position, to, WHITE), moves, QUEEN, position);
-				add_capture_move(from, to, BLACK, PAWN, piece_at_square(position, to, WHITE), moves, ROOK, position);
-				add_capture_move(from, to, BLACK, PAWN, piece_at_square(position, to, WHITE), moves, BISHOP, position);
-				add_capture_move(from, to, BLACK, PAWN, piece_at_square(position, to, WHITE), moves, KNIGHT, position);
-			}
-			capture_squares_w = reset_lsb(capture_squares_w);
-		}
-		uint64_t capture_squares_e = ((position.p[BLACK][PAWN] & ~SE_BORDER) >> 7) & (white_squares | (meta_info & ROW_3));
-		while (capture_squares_e) {
-			int to = lsb_to_square(capture_squares_e);
-			int from = to + 7;
-			if (to >= 8) {
-				add_capture_move(from, to, BLACK, PAWN, piece_at_square(position, to, WHITE), moves, EMPTY, position);
-			} else {
-				add_capture_move(from, to, BLACK, PAWN, piece_at_square(position, to, WHITE), moves, QUEEN, position);
-				add_capture_move(from, to, BLACK, PAWN, piece_at_square(position, to, WHITE), moves, ROOK, position);
-				add_capture_move(from, to, BLACK, PAWN, piece_at_square(position, to, WHITE), moves, BISHOP, position);
-				add_capture_move(from, to, BLACK, PAWN, piece_at_square(position, to, WHITE), moves, KNIGHT, position);
-			}
-			capture_squares_e = reset_lsb(capture_squares_e);
-		}
-		// black king moves
-		uint64_t king = position.p[BLACK][KING];
-		int from = lsb_to_square(king);
-		to_squares = king_moves[from] & ~black_squares;
-		while (to_squares) {
-			uint64_t lsb = lsb(to_squares);
-			int to = lsb_to_square(to_squares);
-			if (lsb & white_squares) {
-				add_capture_move(from, to, BLACK, KING, piece_at_board(position, lsb, WHITE), moves, EMPTY, position);
-			} else {
-				add_quite_move(from, to, BLACK, KING, moves, EMPTY);
+	}
+}
+
+/*
+ * Adds the moves of the type to moves, specialised for each side and type. All but the evasions are pseudo legal,
+ * info is only used for the evasions
+ */
+template<int side, GenType type>
+void generate(const Position& position, const CheckInfo& info, MoveList& moves) {
+	const int opponent = side ^ 1;
+	uint64_t occupied_squares = occupancy(position);
+	int king = lsb_to_square(position.p[side][KING]);
+	// the pieces to generate moves for, and the squares they may move to
+	uint64_t pieces = occupancy(position, side);
+	uint64_t targets = type == CAPTURES ? occupancy(position, opponent) : ~occupied_squares;
+	// the squares each piece type gives check from, for the quiet checks
+	uint64_t knight_targets = ~0ULL;
+	uint64_t bishop_targets = ~0ULL;
+	uint64_t rook_targets = ~0ULL;
+	uint64_t pawn_targets = ~0ULL;
+
+	if (type == EVASIONS) {
+		// king moves to squares that are not attacked, the king does not block the attacks of sliders behind it
+		uint64_t king_targets = 0;
+		for (uint64_t b = king_moves[king] & ~occupancy(position, side); b; b = reset_lsb(b)) {
+			if (!(attackers_to(position, lsb_to_square(b), occupied_squares ^ (1ULL << king))
+					& occupancy(position, opponent))) {
+				king_targets |= lsb(b);
 			}
-			to_squares -= lsb;
 		}
-		// castling
-		if ((meta_info & G8) && !(occupied_squares & black_king_side_castle_squares) && (position.p[BLACK][ROOK] & H8)) {
-			add_castle_move(from, lsb_to_square(G8), BLACK, moves);
+		add_moves<side, type>(position, king, KING, king_targets, moves);
+		if (reset_lsb(info.checkers)) {
+			// double check, only the king can move
+			return;
 		}
-		if ((meta_info & C8) && !(occupied_squares & black_queen_side_castle_squares) && (position.p[BLACK][ROOK] & A8)) {
-			add_castle_move(from, lsb_to_square(C8), BLACK, moves);
+		// capture the checking piece or block the check. A pinned piece can do neither
+		targets = info.checkers | between_squares[king][lsb_to_square(info.checkers)];
+		pieces &= ~info.pinned;
+	}
+	if (type == QUIET_CHECKS) {
+		int opponent_king = info.opponent_king_square;
+		knight_targets = info.check_squares[KNIGHT];
+		bishop_targets = info.check_squares[BISHOP];
+		rook_targets = info.check_squares[ROOK];
+		pawn_targets = info.check_squares[PAWN];
+		// moving a piece off the line between a slider and the opponent king gives a discovered check
+		uint64_t discovered = info.discovered_checks;
+		for (uint64_t b = discovered & ~position.p[side][PAWN]; b; b = reset_lsb(b)) {
+			int from = lsb_to_square(b);
+			int piece = position.board[from];
+			uint64_t check_targets = piece == KNIGHT ? knight_targets : piece == BISHOP ? bishop_targets
+					: piece == ROOK ? rook_targets : piece == QUEEN ? bishop_targets | rook_targets : 0;
+			add_moves<side, type>(position, from, piece, piece_attacks(piece, from, occupied_squares) & targets
+					& (~line_squares[opponent_king][from] | check_targets), moves);
 		}
+		// the pushes of the pawns not on the file of the king leave the line
+		uint64_t discovered_pawns = discovered & position.p[side][PAWN] & ~file_fill(1ULL << opponent_king);
+		generate_pawn_moves<side, QUIET_CHECKS>(position, discovered_pawns, targets, info, moves);
+		pieces &= ~discovered;
 	}
 
+	generate_piece_moves<side, type, KNIGHT>(position, pieces & position.p[side][KNIGHT], targets & knight_targets, moves);
+	generate_piece_moves<side, type, BISHOP>(position, pieces & position.p[side][BISHOP], targets & bishop_targets, moves);
+	generate_piece_moves<side, type, ROOK>(position, pieces & position.p[side][ROOK], targets & rook_targets, moves);
+	generate_piece_moves<side, type, QUEEN>(position, pieces & position.p[side][QUEEN],
+			targets & (bishop_targets | rook_targets), moves);
+	generate_pawn_moves<side, type>(position, pieces & position.p[side][PAWN], targets & pawn_targets, info, moves);
+	if (type == CAPTURES || type == QUIETS) {
+		add_moves<side, type>(position, king, KING, king_moves[king] & targets, moves);
+	}
+	if (type == QUIETS) {
+		generate_castling_moves<side>(position, moves);
+	}
+}
+
+template<GenType type>
+MoveList generate(const Position& position, const bool white_turn, const CheckInfo& info) {
+	MoveList moves;
+	if ((position.p[WHITE][KING] == 0) || (position.p[BLACK][KING]) == 0) {
+		return moves;
+	}
+	if (white_turn) {
+		generate<WHITE, type>(position, info, moves);
+	} else {
+		generate<BLACK, type>(position, info, moves);
+	}
 	return moves;
 }
 
-uint64_t ull_rand() {
-	uint64_t number = ((uint64_t)rand()) << 32;
-	number |= rand();
-	return number;
 }
 
-void init() {
+MoveList get_captures(const Position& position, const bool white_turn) {
+	return generate<CAPTURES>(position, white_turn, CheckInfo());
+}
 
-	rook_castle_to_squares[2] = 3;
-	rook_castle_to_squares[6] = 5;
-	rook_castle_to_squares[62] = 61;
-	rook_castle_to_squares[58] = 59;
-	rook_castle_from_squares[2] = 0;
-	rook_castle_from_squares[6] = 7;
-	rook_castle_from_squares[62] = 63;
-	rook_castle_from_squares[58] = 56;
+MoveList get_quiet_moves(const Position& position, const bool white_turn) {
+	return generate<QUIETS>(position, white_turn, CheckInfo());
+}
 
-	for (int i = 0; i < 64; i++) {
-		uint64_t b = 1ULL << i;
-		uint64_t to_squares = ((b & ~NNW_BORDER) << 15) | ((b & ~NNE_BORDER) << 17) | ((b & ~EEN_BORDER) << 10)
-				| ((b & ~WWN_BORDER) << 6) | ((b & ~EES_BORDER) >> 6) | ((b & ~SSE_BORDER) >> 15)
-				| ((b & ~SSW_BORDER) >> 17) | ((b & ~WWS_BORDER) >> 10);
-		knight_moves[i] = to_squares;
+MoveList get_moves(const Position& position, const bool white_turn) {
+	MoveList moves;
+	if ((position.p[WHITE][KING] == 0) || (position.p[BLACK][KING]) == 0) {
+		return moves;
 	}
-	for (int i = 0; i < 64; i++) {
-		uint64_t b = 1ULL << i;
-		uint64_t to_squares = ((b & ~NW_BORDER) << 7) | ((b & ~NE_BORDER) << 9) | ((b & ~ROW_8) << 8)
-				| ((b & ~H_FILE) << 1) | ((b & ~A_FILE) >> 1) | ((b & ~ROW_1) >> 8) | ((b & ~SW_BORDER) >> 9)
-				| ((b & ~SE_BORDER) >> 7);
+	// the captures first, then the quiet moves and castling moves
+	if (white_turn) {
+		generate<WHITE, CAPTURES>(position, CheckInfo(), moves);
+		generate<WHITE, QUIETS>(position, CheckInfo(), moves);
+	} else {
+		generate<BLACK, CAPTURES>(position, CheckInfo(), moves);
+		generate<BLACK, QUIETS>(position, CheckInfo(), moves);
+	}
+	return moves;
+}
 
-		king_moves[i] = to_squares;
+MoveList get_evasions(const Position& position, const bool white_turn, const CheckInfo& info) {
+	return generate<EVASIONS>(position, white_turn, info);
+}
+
+MoveList get_quiet_checks(const Position& position, const bool white_turn, const CheckInfo& info) {
+	return generate<QUIET_CHECKS>(position, white_turn, info);
+}
+
+bool gives_check(const Position& position, const CheckInfo& info, uint32_t move) {
+	int from = from_square(move);
+	int to = to_square(move);
+	int side = color(move);
+	uint64_t opponent_king = 1ULL << info.opponent_king_square;
+	int promotion_piece = promotion_piece(move);
+	if (piece(move) != KING && promotion_piece == EMPTY && (info.check_squares[piece(move)] & (1ULL << to))) {
+		return true;
 	}
-	srand(123456);
-	for (int i = 0; i < 64; i++) {
-		from_randoms[i] = ull_rand();
-		to_randoms[i] = ull_rand();
+	if ((info.discovered_checks & (1ULL << from)) && !(line_squares[info.opponent_king_square][from] & (1ULL << to))) {
+		return true;
+	}
+	uint64_t occupied_squares = occupancy(position) ^ (1ULL << from);
+	if (promotion_piece != EMPTY) {
+		// the promoted piece may attack the king through the square of the pawn
+		return piece_attacks(promotion_piece, to, occupied_squares) & opponent_king;
+	}
+	if (is_castling(move)) {
+		int rook_to = rook_castle_to_square(to);
+		occupied_squares = (occupied_squares ^ (1ULL << rook_castle_from_square(to))) | (1ULL << to) | (1ULL << rook_to);
+		return rook_attacks(occupied_squares, rook_to) & opponent_king;
+	}
+	if (captured_piece(move) == EN_PASSANT) {
+		// the captured pawn may have blocked a slider, on the row of the king as well
+		int captured_square = side == WHITE ? to - 8 : to + 8;
+		occupied_squares = (occupied_squares ^ (1ULL << captured_square)) | (1ULL << to);
+		return (bishop_attacks(occupied_squares, info.opponent_king_square)
+				& (position.p[side][BISHOP] | position.p[side][QUEEN]))
+				| (rook_attacks(occupied_squares, info.opponent_king_square)
+				& (position.p[side][ROOK] | position.p[side][QUEEN]));
 	}
-	init_magic_lookup_table();
+	return false;
 }
 
-bool is_illegal_castling_move(const Move& move, const uint64_t attacked_squares_by_opponent) {
-	uint64_t to_square = 1ULL << to_square(move.m);
-	if (to_square == C1) {
-		return (C1 | D1 | E1) & attacked_squares_by_opponent;
+bool is_pseudo_legal(const Position& position, const bool white_turn, uint32_t move) {
+	int side = white_turn ? WHITE : BLACK;
+	if (move == 0 || (int) color(move) != side || piece(move) > KING) {
+		return false;
 	}
-	if (to_square == G1) {
-		return (E1 | F1 | G1) & attacked_squares_by_opponent;
+	int from = from_square(move);
+	int to = to_square(move);
+	uint64_t from_square = 1ULL << from;
+	uint64_t to_square = 1ULL << to;
+	if (!(position.p[side][piece(move)] & from_square)) {
+		return false;
 	}
-	if (to_square == C8) {
-		return (C8 | D8 | E8) & attacked_squares_by_opponent;
+	uint64_t occupied_squares = occupancy(position);
+	uint64_t meta_info = current_state(position).meta_info;
+	if (is_castling(move)) {
+		// the same conditions as in get_moves, castling through check is found by is_legal
+		if (white_turn && from == 4 && to == 6) {
+			return (meta_info & G1) && !(occupied_squares & white_king_side_castle_squares) && (position.p[WHITE][ROOK] & H1);
+		}
+		if (white_turn && from == 4 && to == 2) {
+			return (meta_info & C1) && !(occupied_squares & white_queen_side_castle_squares) && (position.p[WHITE][ROOK] & A1);
+		}
+		if (!white_turn && from == 60 && to == 62) {
+			return (meta_info & G8) && !(occupied_squares & black_king_side_castle_squares) && (position.p[BLACK][ROOK] & H8);
+		}
+		if (!white_turn && from == 60 && to == 58) {
+			return (meta_info & C8) && !(occupied_squares & black_queen_side_castle_squares) && (position.p[BLACK][ROOK] & A8);
+		}
+		return false;
 	}
-	if (to_square == G8) {
-		return (E8 | F8 | G8) & attacked_squares_by_opponent;
+	int captured_piece = captured_piece(move);
+	if (captured_piece == EN_PASSANT) {
+		if (piece(move) != PAWN || !(to_square & meta_info & (white_turn ? ROW_6 : ROW_3))) {
+			return false;
+		}
+	} else if (captured_piece != EMPTY) {
+		if (captured_piece > KING || !(position.p[side ^ 1][captured_piece] & to_square)) {
+			return false;
+		}
+	} else if (occupied_squares & to_square) {
+		return false;
 	}
-	return false;
+	bool last_row = to_square & (ROW_8 | ROW_1);
+	if ((promotion_piece(move) != EMPTY) != (piece(move) == PAWN && last_row)) {
+		return false;
+	}
+	switch (piece(move)) {
+	case PAWN:
+		if (captured_piece != EMPTY) {
+			uint64_t attacks = white_turn ? ((from_square & ~NW_BORDER) << 7) | ((from_square & ~NE_BORDER) << 9)
+					: ((from_square & ~SW_BORDER) >> 9) | ((from_square & ~SE_BORDER) >> 7);
+			return attacks & to_square;
+		}
+		if (white_turn) {
+			return to == from + 8 || (to == from + 16 && (from_square & ROW_2) && !(occupied_squares & (from_square << 8)));
+		}
+		return to == from - 8 || (to == from - 16 && (from_square & ROW_7) && !(occupied_squares & (from_square >> 8)));
+	case KNIGHT:
+		return knight_moves[from] & to_square;
+	case BISHOP:
+		return bishop_attacks(occupied_squares, from) & to_square;
+	case ROOK:
+		return rook_attacks(occupied_squares, from) & to_square;
+	case QUEEN:
+		return queen_attacks(occupied_squares, from) & to_square;
+	default:
+		return king_moves[from] & to_square;
+	}
+}
+
+MoveList get_legal_moves(const Position& position, const bool white_turn) {
+	if ((position.p[WHITE][KING] == 0) || (position.p[BLACK][KING]) == 0) {
+		return MoveList();
+	}
+	CheckInfo info = check_info(position, white_turn);
+	if (info.checkers) {
+		return get_evasions(position, white_turn, info);
+	}
+	MoveList moves = get_moves(position, white_turn);
+	unsigned int legal_moves = 0;
+	for (unsigned int i = 0; i < moves.size(); i++) {
+		if (is_legal(position, info, moves[i].m)) {
+			moves[legal_moves++] = moves[i];
+		}
+	}
+	moves.resize(legal_moves);
+	return moves;
 }
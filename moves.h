@@ -39,70 +39,118 @@ inline uint64_t file_fill(uint64_t l) {
 	return south_fill(l) | north_fill(l);
 }
 
+/*
+ * static exchange evaluation of the material won by a capture or lost by a quiet move to an attacked square
+ */
 int see(const Position& position, const Move& capturing_move);
 
 MoveList get_captures(const Position& position, const bool white_turn);
 
 MoveList get_moves(const Position& position, const bool white_turn);
 
-uint64_t get_attacked_squares(const Position& position, const bool white_turn);
+/*
+ * the moves of get_moves that are not captures, castling moves first
+ */
+MoveList get_quiet_moves(const Position& position, const bool white_turn);
+
+/*
+ * true if get_moves would generate the move in the position, used for moves that are not generated like the
+ * hash move and killer moves
+ */
+bool is_pseudo_legal(const Position& position, const bool white_turn, uint32_t move);
+
+/*
+ * the pieces of both sides that attack the square, looked up from the square with the sliders blocked by
+ * occupied_squares. Pieces that are not in occupied_squares are not removed
+ */
+uint64_t attackers_to(const Position& position, int square, uint64_t occupied_squares);
+
+/*
+ * the pieces of both sides that attack the square in the position, read from the attack tables when they are
+ * kept up to date
+ */
+inline uint64_t attackers_to(const Position& position, int square) {
+#ifdef INCREMENTAL_ATTACKS
+	return position.attacks_to[square];
+#else
+	return attackers_to(position, square, occupancy(position));
+#endif
+}
+
+/*
+ * true if the king of the side is attacked
+ */
+bool is_in_check(const Position& position, const bool white_turn);
 
-bool is_illegal_castling_move(const Move& root_move, uint64_t attacked_squares_by_opponent);
+/*
+ * What the legality of the moves of the side to move depends on, computed once per node
+ */
+struct CheckInfo {
+	int king_square;
+	uint64_t checkers; // the opponent pieces giving check
+	uint64_t pinned; // the pieces that may only move along the line to the king
+	// what the checks by the side to move depend on, see gives_check
+	int opponent_king_square;
+	uint64_t check_squares[KING]; // the squares each piece type, pawn to queen, gives check from
+	uint64_t discovered_checks; // the pieces that give a discovered check by leaving the line to the opponent king
+};
+
+CheckInfo check_info(const Position& position, const bool white_turn);
+
+/*
+ * true if the pseudo legal move does not leave the king in check
+ */
+bool is_legal(const Position& position, const CheckInfo& info, uint32_t move);
+
+/*
+ * true if the pseudo legal move gives check, without making it. Direct checks are looked up in the check squares
+ * of info, only promotions, castling and en passant captures test the attacks of the position after the move
+ */
+bool gives_check(const Position& position, const CheckInfo& info, uint32_t move);
+
+/*
+ * the legal moves when the side to move is in check
+ */
+MoveList get_evasions(const Position& position, const bool white_turn, const CheckInfo& info);
+
+/*
+ * the quiet moves that give check, directly or by moving a piece off the line of a slider, not promotions or
+ * castling moves. Pseudo legal
+ */
+MoveList get_quiet_checks(const Position& position, const bool white_turn, const CheckInfo& info);
+
+MoveList get_legal_moves(const Position& position, const bool white_turn);
+
+uint64_t get_attacked_squares(const Position& position, const bool white_turn);
 
 /**
- * Returns true if legal move.
+ * Makes a legal move, see get_legal_moves and is_legal
  */
-bool make_move(Position& position, Move& move);
+void make_move(Position& position, Move& move);
 
 void unmake_move(Position& position, Move& move);
 
-void init();
-
-inline int piece_at_board(const Position& position, const uint64_t b, int color) {
-	if (position.p[color][PAWN] & b) {
-		return PAWN;
-	}
-	if (position.p[color][KNIGHT] & b) {
-		return KNIGHT;
-	}
-	if (position.p[color][BISHOP] & b) {
-		return BISHOP;
-	}
-	if (position.p[color][ROOK] & b) {
-		return ROOK;
-	}
-	if (position.p[color][QUEEN] & b) {
-		return QUEEN;
-	}
-	if (position.p[color][KING] & b) {
-		return KING;
+inline int piece_at_square(const Position& position, int square, int color) {
+	if (position.color_squares[color] & (1ULL << square)) {
+		return position.board[square];
 	}
 	// if there is no piece at target square, then it must be an en passant capture
 	return EN_PASSANT;
 }
 
-inline int piece_at_square(const Position& position, int square, int color) {
-	return piece_at_board(position, (1ULL << square), color);
-}
-
-extern uint64_t from_randoms[64];
-extern uint64_t to_randoms[64];
-
+extern const uint64_t black_turn_random;
 
 /**
- * To avoid hash collisions of similiar positions we xor move info with pre-generated 64-bit random numbers
+ * Zobrist key of the position computed from scratch, make_move and unmake_move keep hash_key equal to it
  */
-inline uint64_t move_hash(uint32_t move) {
-	uint64_t move_64 = ((uint64_t) move) << 32 | move;
-	return from_randoms[from_square(move)] ^ to_randoms[to_square(move)] ^ move_64;
-}
+uint64_t zobrist_key(const Position& position, bool white_turn);
 
 inline void make_null_move(Position& position) {
-	position.hash_key = position.hash_key ^ from_randoms[0];
+	position.hash_key = position.hash_key ^ black_turn_random;
 }
 
 inline void unmake_null_move(Position& position) {
-	position.hash_key = position.hash_key ^ from_randoms[0];
+	position.hash_key = position.hash_key ^ black_turn_random;
 }
 
 #endif /* MOVES_H_ */
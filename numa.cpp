@@ -0,0 +1,270 @@
+/*
+ * Gunborg - UCI chess engine
+ * Copyright (C) 2013-2015 Torbjörn Nilsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * numa.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Torbjörn Nilsson
+ */
+
+#include "numa.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+AffinityMode affinity_mode = AFFINITY_NONE;
+
+// cpus of each numa node, read once from sysfs
+std::vector<std::vector<int> > node_cpus;
+
+const uint64_t PAGE_SIZE_BYTES = 4096;
+
+#ifdef __linux__
+/*
+ * the cpus the process may run on when it starts, set by taskset or a cgroup cpuset
+ */
+cpu_set_t process_cpu_set() {
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			CPU_SET(cpu, &cpu_set);
+		}
+	}
+	return cpu_set;
+}
+
+const cpu_set_t original_cpu_set = process_cpu_set();
+
+// true if the calling thread has been bound to the cpus of a search thread
+thread_local bool thread_pinned = false;
+#endif
+
+/*
+ * parses a sysfs cpu list like "0-3,8-11"
+ */
+std::vector<int> parse_cpu_list(const std::string& cpu_list) {
+	std::vector<int> cpus;
+	std::stringstream ss(cpu_list);
+	std::string range;
+	while (getline(ss, range, ',')) {
+		std::string::size_type dash = range.find('-');
+		int first = atoi(range.c_str());
+		int last = dash == std::string::npos ? first : atoi(range.substr(dash + 1).c_str());
+		for (int cpu = first; cpu <= last; cpu++) {
+			cpus.push_back(cpu);
+		}
+	}
+	return cpus;
+}
+
+const std::vector<std::vector<int> >& get_node_cpus() {
+	if (!node_cpus.empty()) {
+		return node_cpus;
+	}
+	for (int node = 0; ; node++) {
+		std::ifstream cpu_list_file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+		std::string cpu_list;
+		if (!cpu_list_file || !getline(cpu_list_file, cpu_list)) {
+			break;
+		}
+		std::vector<int> cpus = parse_cpu_list(cpu_list);
+		if (!cpus.empty()) {
+			node_cpus.push_back(cpus);
+		}
+	}
+	if (node_cpus.empty()) {
+		// no numa information, one node with all cpus
+		std::vector<int> cpus;
+		int no_cpus = std::thread::hardware_concurrency();
+		for (int cpu = 0; cpu < (no_cpus > 0 ? no_cpus : 1); cpu++) {
+			cpus.push_back(cpu);
+		}
+		node_cpus.push_back(cpus);
+	}
+	return node_cpus;
+}
+
+/*
+ * the cpus search thread thread_index should run on, empty if any
+ */
+std::vector<int> thread_cpus(int thread_index) {
+	const std::vector<std::vector<int> >& nodes = get_node_cpus();
+	const std::vector<int>& cpus = nodes[thread_index % nodes.size()];
+	if (affinity_mode == AFFINITY_NODE) {
+		return cpus;
+	}
+	if (affinity_mode == AFFINITY_CORE) {
+		return std::vector<int>(1, cpus[(thread_index / nodes.size()) % cpus.size()]);
+	}
+	return std::vector<int>();
+}
+
+void first_touch(char* memory, uint64_t bytes, int thread_index) {
+	pin_thread(thread_index);
+	memset(memory, 0, bytes);
+}
+
+}
+
+void set_affinity_mode(AffinityMode mode) {
+	affinity_mode = mode;
+}
+
+AffinityMode get_affinity_mode() {
+	return affinity_mode;
+}
+
+const char* affinity_mode_name(AffinityMode mode) {
+	return mode == AFFINITY_CORE ? "core" : mode == AFFINITY_NODE ? "node" : "none";
+}
+
+AffinityMode parse_affinity_mode(const std::string& line) {
+	std::string::size_type pos = line.find("value");
+	std::string value = pos != std::string::npos ? line.substr(pos + 6) : "";
+	if (value.find("core") == 0) {
+		return AFFINITY_CORE;
+	}
+	if (value.find("node") == 0) {
+		return AFFINITY_NODE;
+	}
+	return AFFINITY_NONE;
+}
+
+int numa_node_count() {
+	return get_node_cpus().size();
+}
+
+void pin_thread(int thread_index) {
+#ifdef __linux__
+	std::vector<int> cpus = thread_cpus(thread_index);
+	if (cpus.empty()) {
+		if (thread_pinned) {
+			// pinned in an earlier search, allow the cpus of the process again
+			pthread_setaffinity_np(pthread_self(), sizeof(original_cpu_set), &original_cpu_set);
+			thread_pinned = false;
+		}
+		return;
+	}
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	for (int cpu : cpus) {
+		CPU_SET(cpu, &cpu_set);
+	}
+	pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+	thread_pinned = true;
+#endif
+}
+
+Transposition* allocate_tt(uint64_t size, int threads) {
+#ifdef __linux__
+	uint64_t bytes = size * sizeof(Transposition);
+	void* memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory != MAP_FAILED) {
+		if (affinity_mode != AFFINITY_NONE) {
+			// first touch, the kernel places a page on the node of the thread that first writes it
+			char* bytes_ptr = static_cast<char*>(memory);
+			std::vector<std::thread> touch_threads;
+			for (int i = 0; i < threads; i++) {
+				uint64_t first = (bytes / PAGE_SIZE_BYTES) * i / threads * PAGE_SIZE_BYTES;
+				uint64_t last = (bytes / PAGE_SIZE_BYTES) * (i + 1) / threads * PAGE_SIZE_BYTES;
+				if (i == threads - 1) {
+					last = bytes;
+				}
+				touch_threads.push_back(std::thread(first_touch, bytes_ptr + first, last - first, i));
+			}
+			for (auto& touch_thread : touch_threads) {
+				touch_thread.join();
+			}
+		}
+		// anonymous pages are zero. when not pinned the pages are placed where the searching threads first write them
+		return static_cast<Transposition*>(memory);
+	}
+	throw std::bad_alloc();
+#else
+	return new Transposition[size];
+#endif
+}
+
+void free_tt(Transposition* tt, uint64_t size) {
+#ifdef __linux__
+	munmap(tt, size * sizeof(Transposition));
+#else
+	delete[] tt;
+#endif
+}
+
+void print_numa_info(Transposition* tt, uint64_t size, int threads) {
+	int no_nodes = numa_node_count();
+	std::cout << "numa nodes " << no_nodes << " thread affinity " << affinity_mode_name(affinity_mode) << "\n";
+#if defined(__linux__) && defined(SYS_move_pages)
+	// sample the node of up to 4096 pages of the table
+	uint64_t no_pages = size * sizeof(Transposition) / PAGE_SIZE_BYTES;
+	uint64_t no_samples = no_pages < 4096 ? no_pages : 4096;
+	if (no_samples == 0) {
+		return;
+	}
+	std::vector<void*> pages(no_samples);
+	std::vector<int> status(no_samples);
+	for (uint64_t i = 0; i < no_samples; i++) {
+		pages[i] = reinterpret_cast<char*>(tt) + (i * no_pages / no_samples) * PAGE_SIZE_BYTES;
+	}
+	// with no target nodes, move_pages only reports the node of each page
+	if (syscall(SYS_move_pages, 0, no_samples, pages.data(), NULL, status.data(), 0) != 0) {
+		return;
+	}
+	std::vector<uint64_t> node_pages(no_nodes);
+	uint64_t placed_pages = 0;
+	for (int node : status) {
+		if (node >= 0 && node < no_nodes) {
+			node_pages[node]++;
+			placed_pages++;
+		}
+	}
+	std::cout << "tt pages per node";
+	for (int node = 0; node < no_nodes; node++) {
+		std::cout << " " << node << ":" << (placed_pages ? 100 * node_pages[node] / placed_pages : 0) << "%";
+	}
+	std::cout << " (" << placed_pages << " of " << no_samples << " sampled pages placed)\n";
+	if (affinity_mode != AFFINITY_NONE && placed_pages > 0) {
+		// a model, not a measurement: assumes the probes are spread evenly over the table and that thread i
+		// runs on node i % nodes, the remote share is then the pages on the other nodes
+		uint64_t remote_pages = 0;
+		for (int i = 0; i < threads; i++) {
+			remote_pages += placed_pages - node_pages[i % no_nodes];
+		}
+		std::cout << "modeled remote tt accesses " << 100 * remote_pages / (placed_pages * threads)
+				<< "% (estimate from the page placement, see bench numa for measured nps)\n";
+	}
+#endif
+}
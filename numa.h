@@ -0,0 +1,76 @@
+/*
+ * Gunborg - UCI chess engine
+ * Copyright (C) 2013-2015 Torbjörn Nilsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * numa.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Torbjörn Nilsson
+ */
+
+#ifndef NUMA_H_
+#define NUMA_H_
+
+#include "Cache.h"
+#include <string>
+
+/*
+ * How search threads are bound to cpus
+ *
+ * AFFINITY_NONE: the os scheduler decides
+ * AFFINITY_CORE: search thread i is bound to one core
+ * AFFINITY_NODE: search thread i is bound to all cores of one numa node
+ *
+ * In both core and node mode thread i runs on node i % number of nodes, i.e. the threads are spread over the nodes
+ */
+enum AffinityMode {
+	AFFINITY_NONE, AFFINITY_CORE, AFFINITY_NODE
+};
+
+void set_affinity_mode(AffinityMode mode);
+
+AffinityMode get_affinity_mode();
+
+const char* affinity_mode_name(AffinityMode mode);
+
+AffinityMode parse_affinity_mode(const std::string& line);
+
+int numa_node_count();
+
+/*
+ * binds the calling thread to the cpus of search thread thread_index (0 is the main search thread). Without
+ * affinity the thread runs on the cpus the process started with, so a taskset or cpuset mask is kept
+ */
+void pin_thread(int thread_index);
+
+/*
+ * Allocates a zeroed transposition table.
+ *
+ * When the search threads are pinned, each of the search threads first touches a slice of the table from
+ * its own cpus, so the pages are spread over the nodes that the search threads run on.
+ */
+Transposition* allocate_tt(uint64_t size, int threads);
+
+void free_tt(Transposition* tt, uint64_t size);
+
+/*
+ * prints on which nodes the pages of the transposition table are. With pinned threads it also prints a modeled
+ * share of remote table accesses, computed from the page placement assuming evenly spread probes. It is an
+ * estimate, the measured effect of the affinity modes is printed by bench_numa.
+ */
+void print_numa_info(Transposition* tt, uint64_t size, int threads);
+
+#endif /* NUMA_H_ */
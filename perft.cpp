@@ -0,0 +1,139 @@
+/*
+ * Gunborg - UCI chess engine
+ * Copyright (C) 2013-2015 Torbjörn Nilsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * perft.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Torbjörn Nilsson
+ */
+
+#include "perft.h"
+#include "moves.h"
+#include "util.h"
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const uint64_t COUNT_MASK = (1ULL << 56) - 1;
+
+inline bool probe(PerftEntry* table, uint64_t table_size, uint64_t key, int depth, uint64_t& count) {
+	PerftEntry& entry = table[key & (table_size - 1)];
+	uint64_t data = entry.data;
+	if ((entry.key ^ data) != key || (int) (data >> 56) != depth) {
+		return false;
+	}
+	count = data & COUNT_MASK;
+	return true;
+}
+
+inline void store(PerftEntry* table, uint64_t table_size, uint64_t key, int depth, uint64_t count) {
+	PerftEntry& entry = table[key & (table_size - 1)];
+	uint64_t data = ((uint64_t) depth << 56) | (count & COUNT_MASK);
+	entry.key = key ^ data;
+	entry.data = data;
+}
+
+uint64_t hashed_perft(Position& position, int depth, bool white_turn, PerftEntry* table, uint64_t table_size) {
+	MoveList moves = get_legal_moves(position, white_turn);
+	if (depth == 1) {
+		// bulk counting, the legal moves are the leaves
+		return moves.size();
+	}
+	uint64_t nodes = 0;
+	uint64_t key = position.hash_key;
+	if (probe(table, table_size, key, depth, nodes)) {
+		return nodes;
+	}
+	for (auto move : moves) {
+		make_move(position, move);
+		nodes += hashed_perft(position, depth - 1, !white_turn, table, table_size);
+		unmake_move(position, move);
+	}
+	store(table, table_size, key, depth, nodes);
+	return nodes;
+}
+
+/*
+ * the root moves, shared by the perft threads
+ */
+struct PerftRoot {
+	Position position;
+	bool white_turn;
+	int depth;
+	MoveList moves;
+	std::vector<uint64_t> counts;
+	std::atomic_int next_move;
+	PerftEntry* table;
+	uint64_t table_size;
+};
+
+/*
+ * takes the next root move until all are counted
+ */
+void count_root_moves(PerftRoot* root) {
+	Position position = root->position;
+	for (int i = root->next_move++; i < (int) root->moves.size(); i = root->next_move++) {
+		Move move = root->moves[i];
+		make_move(position, move);
+		root->counts[i] = root->depth == 1 ? 1 : hashed_perft(position, root->depth - 1, !root->white_turn, root->table,
+				root->table_size);
+		unmake_move(position, move);
+	}
+}
+
+}
+
+uint64_t fast_perft(const Position& position, int depth, bool white_turn, int threads, uint64_t table_size,
+		bool divide) {
+	if (depth == 0) {
+		return 1;
+	}
+	PerftRoot root;
+	root.position = position;
+	root.white_turn = white_turn;
+	root.depth = depth;
+	root.moves = get_legal_moves(root.position, white_turn);
+	root.counts.resize(root.moves.size());
+	root.next_move = 0;
+	root.table = new PerftEntry[table_size]();
+	root.table_size = table_size;
+
+	std::vector<std::thread> perft_threads;
+	for (int i = 1; i < threads; i++) {
+		perft_threads.push_back(std::thread(count_root_moves, &root));
+	}
+	count_root_moves(&root);
+	for (auto& perft_thread : perft_threads) {
+		perft_thread.join();
+	}
+	delete[] root.table;
+
+	uint64_t nodes = 0;
+	for (unsigned int i = 0; i < root.moves.size(); i++) {
+		if (divide) {
+			std::cout << uci_move(root.moves[i].m) << ": " << root.counts[i] << "\n";
+		}
+		nodes += root.counts[i];
+	}
+	if (divide) {
+		std::cout << "moves: " << root.moves.size() << " nodes: " << nodes << "\n" << std::flush;
+	}
+	return nodes;
+}
@@ -0,0 +1,48 @@
+/*
+ * Gunborg - UCI chess engine
+ * Copyright (C) 2013-2015 Torbjörn Nilsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * perft.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Torbjörn Nilsson
+ */
+
+#ifndef PERFT_H_
+#define PERFT_H_
+
+#include "board.h"
+
+/*
+ * A perft entry, the key is stored xor the data so a torn entry is a miss, like in the transposition table.
+ * data is the count in bit 0-55 and the depth in bit 56-63
+ */
+struct PerftEntry {
+	uint64_t key;
+	uint64_t data;
+};
+
+/*
+ * Counts the leaf nodes at depth, like perft in util.h but faster. The last ply is only counted, the counts of
+ * subtrees are stored in a hash table with table_size entries (a power of two) and the root moves are split
+ * between threads.
+ *
+ * With divide the count of each root move is printed.
+ */
+uint64_t fast_perft(const Position& position, int depth, bool white_turn, int threads, uint64_t table_size,
+		bool divide);
+
+#endif /* PERFT_H_ */
@@ -0,0 +1,129 @@
+/*
+ * Gunborg - UCI chess engine
+ * Copyright (C) 2013-2015 Torbjörn Nilsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * shared_hash.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Torbjörn Nilsson
+ */
+
+#include "shared_hash.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// "GUNBTT" and the version of the entry format, processes with another entry format must not attach
+const uint64_t SHARED_TT_MAGIC = 0x47554e4254540001ULL;
+
+/*
+ * first in the segment, followed by the entries
+ */
+struct SharedTTHeader {
+	std::atomic<uint64_t> magic; // written last by the creating process
+	uint64_t size;
+	char padding[48];
+};
+
+std::string segment_name(const std::string& name) {
+	return name[0] == '/' ? name : "/" + name;
+}
+
+}
+
+Transposition* attach_shared_tt(const std::string& name, uint64_t& size) {
+#ifdef __linux__
+	if (name.empty()) {
+		return NULL;
+	}
+	bool created = true;
+	int fd = shm_open(segment_name(name).c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0 && errno == EEXIST) {
+		created = false;
+		fd = shm_open(segment_name(name).c_str(), O_RDWR, 0);
+	}
+	if (fd < 0) {
+		return NULL;
+	}
+	uint64_t bytes = sizeof(SharedTTHeader) + size * sizeof(Transposition);
+	if (created) {
+		// the new pages are zero, i.e. an empty table
+		if (ftruncate(fd, bytes) != 0) {
+			close(fd);
+			shm_unlink(segment_name(name).c_str());
+			return NULL;
+		}
+	} else {
+		// the creating process may not have sized the segment yet
+		struct stat st;
+		for (int i = 0; fstat(fd, &st) == 0 && (uint64_t) st.st_size < sizeof(SharedTTHeader) && i < 1000; i++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		if (fstat(fd, &st) != 0 || (uint64_t) st.st_size <= sizeof(SharedTTHeader)) {
+			close(fd);
+			return NULL;
+		}
+		bytes = st.st_size;
+	}
+	void* memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED) {
+		return NULL;
+	}
+	SharedTTHeader* header = static_cast<SharedTTHeader*>(memory);
+	if (created) {
+		header->size = size;
+		header->magic.store(SHARED_TT_MAGIC, std::memory_order_release);
+	} else {
+		for (int i = 0; header->magic.load(std::memory_order_acquire) == 0 && i < 1000; i++) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		if (header->magic.load(std::memory_order_acquire) != SHARED_TT_MAGIC
+				|| sizeof(SharedTTHeader) + header->size * sizeof(Transposition) != bytes) {
+			munmap(memory, bytes);
+			return NULL;
+		}
+		size = header->size;
+	}
+	return reinterpret_cast<Transposition*>(header + 1);
+#else
+	return NULL;
+#endif
+}
+
+void detach_shared_tt(Transposition* tt, uint64_t size) {
+#ifdef __linux__
+	munmap(reinterpret_cast<SharedTTHeader*>(tt) - 1, sizeof(SharedTTHeader) + size * sizeof(Transposition));
+#endif
+}
+
+void remove_shared_tt(const std::string& name) {
+#ifdef __linux__
+	if (!name.empty()) {
+		shm_unlink(segment_name(name).c_str());
+	}
+#endif
+}
@@ -0,0 +1,51 @@
+/*
+ * Gunborg - UCI chess engine
+ * Copyright (C) 2013-2015 Torbjörn Nilsson
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * shared_hash.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: Torbjörn Nilsson
+ */
+
+#ifndef SHARED_HASH_H_
+#define SHARED_HASH_H_
+
+#include "Cache.h"
+#include <string>
+
+/*
+ * Maps a transposition table from the named POSIX shared memory segment, so several engine processes can
+ * share it. The entries are lockless (the key is stored xor the data), so no locking between processes is needed.
+ *
+ * The first process creates the segment with size entries. A process attaching to an existing segment
+ * does not clear it, and size is set to the number of entries of the segment.
+ *
+ * Returns NULL if the segment could not be created or attached.
+ */
+Transposition* attach_shared_tt(const std::string& name, uint64_t& size);
+
+/*
+ * unmaps the table, the segment and its entries are kept for other processes
+ */
+void detach_shared_tt(Transposition* tt, uint64_t size);
+
+/*
+ * removes the named segment, processes that have it attached can still use it
+ */
+void remove_shared_tt(const std::string& name);
+
+#endif /* SHARED_HASH_H_ */
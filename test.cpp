@@ -22,9 +22,18 @@
  */
 #include "test.h"
 #include "board.h"
+#include "Cache.h"
+#include "CommandQueue.h"
+#include "fill.h"
+#include "magic.h"
+#include "MovePicker.h"
 #include "moves.h"
+#include "perft.h"
+#include "Search.h"
+#include "shared_hash.h"
 #include "uci.h"
 #include "util.h"
+#include <chrono>
 #include <iostream>
 
 int test_count = 0;
@@ -39,10 +48,10 @@ void assert_equals(const char* fail_message, uint64_t value, uint64_t expected)
 
 void white_pawn_push() {
 	Position position;
-	position.meta_info_stack.push_back(0);
 	position.p[WHITE][PAWN] = ROW_3;
 	position.p[WHITE][KING] = A1;
 	position.p[BLACK][KING] = H8;
+	init_position(position);
 	MoveList quites = get_moves(position, true);
 	assert_equals("should be 11 moves", quites.size(), 11);
 	assert_equals("first move from A3", from_square(quites.front().m), lsb_to_square(A3));
@@ -53,10 +62,10 @@ void white_pawn_push() {
 
 void white_pawn_two_square_push() {
 	Position position;
-	position.meta_info_stack.push_back(0);
 	position.p[WHITE][PAWN] = ROW_2;
 	position.p[WHITE][KING] = A1;
 	position.p[BLACK][KING] = H8;
+	init_position(position);
 	MoveList quites = get_moves(position, true);
 	assert_equals("should be 17 moves", quites.size(), 17);
 	assert_equals("first move from A2", from_square(quites.front().m), lsb_to_square(A2));
@@ -65,10 +74,10 @@ void white_pawn_two_square_push() {
 
 void black_pawn_two_square_push() {
 	Position position;
-	position.meta_info_stack.push_back(0);
 	position.p[BLACK][PAWN] = ROW_7;
 	position.p[WHITE][KING] = A1;
 	position.p[BLACK][KING] = H8;
+	init_position(position);
 	MoveList quites = get_moves(position, false);
 	assert_equals("should be 17 moves", quites.size(), 17);
 	assert_equals("first move from A7", from_square(quites.front().m), lsb_to_square(A7));
@@ -77,10 +86,10 @@ void black_pawn_two_square_push() {
 
 void black_pawn_push() {
 	Position position;
-	position.meta_info_stack.push_back(0);
 	position.p[BLACK][PAWN] = ROW_6;
 	position.p[WHITE][KING] = A1;
 	position.p[BLACK][KING] = H8;
+	init_position(position);
 	MoveList quites = get_moves(position, false);
 	assert_equals("b should be 11 moves", quites.size(), 11);
 	assert_equals("first move from A6", from_square(quites.front().m), lsb_to_square(A6));
@@ -89,24 +98,24 @@ void black_pawn_push() {
 
 void white_blocked_pawn_push() {
 	Position position;
-	position.meta_info_stack.push_back(0);
 	position.p[WHITE][PAWN] = ROW_3;
 	position.p[BLACK][PAWN] = D4;
 	position.p[WHITE][KING] = A1;
 	position.p[BLACK][KING] = H8;
+	init_position(position);
 	MoveList quites = get_moves(position, true);
 	assert_equals("should be 12 moves", quites.size(), 12);
-	assert_equals("first move from A3", from_square(quites.front().m), lsb_to_square(C3));
-	assert_equals("first move to A4", to_square(quites.front().m), lsb_to_square(D4));
+	assert_equals("first move from E3", from_square(quites.front().m), lsb_to_square(E3));
+	assert_equals("first move to D4", to_square(quites.front().m), lsb_to_square(D4));
 }
 
 void pawn_captures() {
 	Position position;
-	position.meta_info_stack.push_back(0);
 	position.p[WHITE][PAWN] = D5;
 	position.p[BLACK][PAWN] = E6;
 	position.p[WHITE][KING] = A1;
 	position.p[BLACK][KING] = H8;
+	init_position(position);
 	MoveList moves = get_moves(position, true);
 	assert_equals("should be 5 moves", moves.size(), 5);
 }
@@ -114,33 +123,172 @@ void pawn_captures() {
 void make_unmake() {
 	Position position;
 	position.p[WHITE][PAWN] = A4;
-	position.meta_info_stack.push_back(0);
+	init_position(position);
 	Move move;
 	move.m = to_move(lsb_to_square(A4), lsb_to_square(A5), WHITE, PAWN, EMPTY);
 
+	position.hash_key = zobrist_key(position, true);
+	uint64_t hash_key = position.hash_key;
+
 	make_move(position, move);
 	assert_equals("Pawn at A5", position.p[WHITE][PAWN], A5);
-	assert_equals("make hash", position.hash_key, move_hash(move.m));
+	assert_equals("make hash", position.hash_key, zobrist_key(position, false));
 	unmake_move(position, move);
 	assert_equals("Pawn unmaked to A4", position.p[WHITE][PAWN], A4);
-	assert_equals("unmake hash", position.hash_key, 0);
+	assert_equals("unmake hash", position.hash_key, hash_key);
+}
+
+/*
+ * makes the legal move in uci notation
+ */
+void play(Position& position, const std::string& move_str, bool white_turn) {
+	for (auto move : get_legal_moves(position, white_turn)) {
+		if (uci_move(move.m) == move_str) {
+			make_move(position, move);
+			return;
+		}
+	}
+	assert_equals(("legal move " + move_str).c_str(), false, true);
+}
+
+void zobrist_keys() {
+	Position position = start_pos().position;
+	uint64_t start_key = position.hash_key;
+	play(position, "g1f3", true);
+	play(position, "g8f6", false);
+	play(position, "f3g1", true);
+	play(position, "f6g8", false);
+	assert_equals("same key after knights return", position.hash_key, start_key);
+
+	Position a = start_pos().position;
+	play(a, "d2d3", true);
+	play(a, "e7e6", false);
+	play(a, "g1f3", true);
+	Position b = start_pos().position;
+	play(b, "g1f3", true);
+	play(b, "e7e6", false);
+	play(b, "d2d3", true);
+	assert_equals("transposition has the same key", a.hash_key, b.hash_key);
+	assert_equals("incremental key equals computed key", a.hash_key, zobrist_key(a, false));
+
+	play(b, "e6e5", false);
+	Position c = a;
+	play(c, "e6e5", false);
+	assert_equals("transposition after more moves", b.hash_key, c.hash_key);
+	Position castling = c;
+	play(c, "e1d2", true);
+	play(c, "e8e7", false);
+	play(c, "d2e1", true);
+	play(c, "e7e8", false);
+	assert_equals("castling rights in key", c.hash_key != castling.hash_key, true);
+
+	FenInfo with_en_passant = parse_fen("rnbqkbnr/ppppp1pp/8/8/4Pp2/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1");
+	FenInfo without_en_passant = parse_fen("rnbqkbnr/ppppp1pp/8/8/4Pp2/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1");
+	assert_equals("en passant in key", with_en_passant.position.hash_key != without_en_passant.position.hash_key, true);
+	FenInfo white_to_move = parse_fen("rnbqkbnr/ppppp1pp/8/8/4Pp2/8/PPPP1PPP/RNBQKBNR w KQkq - 0 1");
+	assert_equals("side to move in key", white_to_move.position.hash_key != without_en_passant.position.hash_key, true);
+
+	FenInfo kiwipete = parse_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -");
+	position = kiwipete.position;
+	uint64_t hash_key = position.hash_key;
+	for (auto move : get_moves(position, true)) {
+		make_move(position, move);
+		assert_equals(("key after " + uci_move(move.m)).c_str(), position.hash_key, zobrist_key(position, false));
+		unmake_move(position, move);
+	}
+	assert_equals("key restored", position.hash_key, hash_key);
+}
+
+void incremental_occupancy_and_board() {
+	FenInfo fen_info = parse_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -");
+	Position position = fen_info.position;
+	uint64_t occupied_squares = occupancy(position);
+	for (auto move : get_moves(position, true)) {
+		make_move(position, move);
+		Position computed = position;
+		init_position(computed);
+		assert_equals(("white squares after " + uci_move(move.m)).c_str(), occupancy(position, WHITE),
+				occupancy(computed, WHITE));
+		assert_equals(("black squares after " + uci_move(move.m)).c_str(), occupancy(position, BLACK),
+				occupancy(computed, BLACK));
+		assert_equals(("occupied squares after " + uci_move(move.m)).c_str(), occupancy(position),
+				occupancy(computed));
+		for (int square = 0; square < 64; square++) {
+			assert_equals(("board after " + uci_move(move.m)).c_str(), (int) position.board[square],
+					(int) computed.board[square]);
+		}
+		unmake_move(position, move);
+	}
+	assert_equals("occupancy restored", occupancy(position), occupied_squares);
+	assert_equals("piece at e2", piece_at_square(position, 12, WHITE), BISHOP);
+	assert_equals("no white piece at e7", piece_at_square(position, 52, WHITE), EN_PASSANT);
+}
+
+/*
+ * true if the attacks of the position are the ones computed from scratch
+ */
+bool attacks_equal(const Position& position) {
+	bool equal = true;
+#ifdef INCREMENTAL_ATTACKS
+	Position computed = position;
+	init_attacks(computed);
+	for (int square = 0; square < 64; square++) {
+		equal = equal && position.attacks_from[square] == computed.attacks_from[square];
+	}
+#endif
+	for (int square = 0; square < 64; square++) {
+		equal = equal && attackers_to(position, square) == attackers_to(position, square, occupancy(position));
+	}
+	return equal;
+}
+
+void incremental_attacks() {
+	const char* fens[] = { "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+			"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+			"8/8/8/R2pP2k/8/8/8/K7 w - d6 0 1" };
+	for (auto fen : fens) {
+		FenInfo fen_info = parse_fen(fen);
+		Position& position = fen_info.position;
+		for (auto move : get_legal_moves(position, fen_info.white_turn)) {
+			make_move(position, move);
+			bool equal = attacks_equal(position);
+			for (auto reply : get_legal_moves(position, !fen_info.white_turn)) {
+				make_move(position, reply);
+				equal = equal && attacks_equal(position);
+				unmake_move(position, reply);
+			}
+			unmake_move(position, move);
+			assert_equals((std::string("attacks after ") + fen + " " + uci_move(move.m)).c_str(),
+					equal && attacks_equal(position), true);
+		}
+	}
 }
 
 void make_unmake_capture() {
 	Position position;
 	position.p[WHITE][PAWN] = A4;
 	position.p[BLACK][PAWN] = B5;
-	position.meta_info_stack.push_back(0);
 
+	init_position(position);
 	Move move;
 	move.m = to_capture_move(lsb_to_square(A4), lsb_to_square(B5), PAWN, PAWN, WHITE, EMPTY);
 
+	current_state(position).halfmove_clock = 7;
+	position.hash_key = zobrist_key(position, true);
+	uint64_t hash_key = position.hash_key;
+
 	make_move(position, move);
 	assert_equals("Pawn at B5", position.p[WHITE][PAWN], B5);
 	assert_equals("Pawn is captured", position.p[BLACK][PAWN], 0);
+	assert_equals("next state", position.ply, 1);
+	assert_equals("captured piece in state", current_state(position).captured_piece, PAWN);
+	assert_equals("halfmove clock reset", current_state(position).halfmove_clock, 0);
 	unmake_move(position, move);
 	assert_equals("Pawn unmaked to A4", position.p[WHITE][PAWN], A4);
 	assert_equals("Captured pawn unmaked to B5", position.p[BLACK][PAWN], B5);
+	assert_equals("previous state", position.ply, 0);
+	assert_equals("halfmove clock restored", current_state(position).halfmove_clock, 7);
+	assert_equals("hash key restored", position.hash_key, hash_key);
 
 }
 
@@ -148,8 +296,8 @@ void make_unmake_king_capture() {
 	Position position;
 	position.p[WHITE][PAWN] = A4;
 	position.p[BLACK][KING] = B5;
-	position.meta_info_stack.push_back(0);
 
+	init_position(position);
 	Move move;
 	move.m = to_capture_move(lsb_to_square(A4), lsb_to_square(B5), PAWN, KING, WHITE, EMPTY);
 
@@ -164,25 +312,28 @@ void make_unmake_king_capture() {
 
 void white_knight_moves() {
 	Position position;
-	position.meta_info_stack.push_back(0);
 	position.p[WHITE][KING] = A1;
 	position.p[BLACK][KING] = H8;
 	position.p[WHITE][KNIGHT] = D4;
+	init_position(position);
 	MoveList quites = get_moves(position, true);
 	assert_equals("should be 11 knight moves", quites.size(), 11);
 
 	position.p[WHITE][KNIGHT] = A1;
+	init_position(position);
 	quites = get_moves(position, true);
 	assert_equals("should be 5 knight moves", quites.size(), 5);
 
 	position.p[WHITE][KNIGHT] = D4;
 	position.p[WHITE][PAWN] = C6 | B5;
+	init_position(position);
 	quites = get_moves(position, true);
 	assert_equals("should be 6 knight + 2 pawn moves + 3 king", quites.size(), 11);
 
 	position.p[WHITE][KNIGHT] = D4;
 	position.p[WHITE][PAWN] = 0;
 	position.p[BLACK][PAWN] = C6 | B5;
+	init_position(position);
 	quites = get_moves(position, true);
 	assert_equals("should be 11 knight moves", quites.size(), 11);
 
@@ -205,33 +356,35 @@ void white_castling() {
 	position.p[WHITE][BISHOP] = 0;
 	position.p[WHITE][ROOK] = H1;
 
-	position.meta_info_stack.push_back(G1);
+	current_state(position).meta_info = G1;
+	init_position(position);
 	MoveList moves = get_moves(position, true);
 	assert_equals("should be 21 white start moves", moves.size(), 21);
-	Move castle_move = moves.front();
+	Move castle_move = moves.back();
 	assert_equals("from square", from_square(castle_move.m), 4);
 	assert_equals("to square", to_square(castle_move.m), 6);
 	assert_equals("piece is king", piece(castle_move.m), KING);
 	assert_equals("is not a capture", is_capture(castle_move.m), 0);
 	assert_equals("is not a promotion", promotion_piece(castle_move.m), EMPTY);
 	make_move(position, castle_move);
-	assert_equals("castle rights removed", position.meta_info_stack.back(), 0);
+	assert_equals("castle rights removed", current_state(position).meta_info, 0);
 	assert_equals("king square", position.p[WHITE][KING], G1);
 	assert_equals("rook square", position.p[WHITE][ROOK], F1);
 	unmake_move(position, castle_move);
 	assert_equals("king is back", position.p[WHITE][KING], E1);
 	assert_equals("rook is back", position.p[WHITE][ROOK], H1);
-	assert_equals("castle rights are given back", position.meta_info_stack.back(), G1);
+	assert_equals("castle rights are given back", current_state(position).meta_info, G1);
 }
 
 void white_en_passant_capture() {
 	Position position;
 	position.p[WHITE][PAWN] = E5;
 	position.p[BLACK][PAWN] = D5;
-	position.meta_info_stack.push_back(D6);
+	current_state(position).meta_info = D6;
 	position.p[WHITE][KING] = A1;
 	position.p[BLACK][KING] = H8;
 
+	init_position(position);
 	MoveList moves = get_moves(position, true);
 	assert_equals("Expect five moves", moves.size(), 5);
 	for (auto it : moves) {
@@ -250,10 +403,11 @@ void black_en_passant_capture() {
 	Position position;
 	position.p[WHITE][PAWN] = E4;
 	position.p[BLACK][PAWN] = D4;
-	position.meta_info_stack.push_back(E3);
+	current_state(position).meta_info = E3;
 	position.p[WHITE][KING] = A1;
 	position.p[BLACK][KING] = H8;
 
+	init_position(position);
 	MoveList moves = get_moves(position, false);
 	assert_equals("Expect five moves", moves.size(), 5);
 	for (auto it : moves) {
@@ -271,6 +425,7 @@ void black_en_passant_capture() {
 void forced_move() {
 	FenInfo fen_info = parse_fen("6k1/pp3pp1/4p2p/8/3P3P/3R2P1/q1K5/4R3 w - - 2 37");
 	Position position = fen_info.position;
+	init_position(position);
 	MoveList moves = get_moves(position, fen_info.white_turn);
 
 	bool in_check = get_attacked_squares(position, !fen_info.white_turn);
@@ -286,6 +441,130 @@ void forced_move() {
 	assert_equals("three legal moves", legal_moves, 3);
 }
 
+void legal_moves() {
+	FenInfo fen_info = parse_fen("6k1/pp3pp1/4p2p/8/3P3P/3R2P1/q1K5/4R3 w - - 2 37");
+	assert_equals("evasions", get_legal_moves(fen_info.position, true).size(), 3);
+	fen_info = parse_fen("4k3/8/8/8/8/5n2/1B6/r3K3 w - - 0 1");
+	assert_equals("double check", get_legal_moves(fen_info.position, true).size(), 2);
+	fen_info = parse_fen("4k3/4r3/8/8/8/8/4N3/4K3 w - - 0 1");
+	assert_equals("pinned knight", get_legal_moves(fen_info.position, true).size(), 4);
+	fen_info = parse_fen("4k3/8/8/KPp3r1/8/8/8/8 w - c6 0 1");
+	for (auto move : get_legal_moves(fen_info.position, true)) {
+		assert_equals("en passant exposes the king", captured_piece(move.m) != EN_PASSANT, true);
+	}
+	fen_info = parse_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -");
+	assert_equals("kiwipete", get_legal_moves(fen_info.position, true).size(), 48);
+	CheckInfo info = check_info(fen_info.position, true);
+	assert_equals("not in check", info.checkers, 0);
+	assert_equals("nothing pinned", info.pinned, 0);
+}
+
+void attackers() {
+	FenInfo fen_info = parse_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -");
+	Position& position = fen_info.position;
+	// d5 is attacked by the pawns on e4 and e6 and the knights on b6, c3 and f6
+	assert_equals("attackers to d5", attackers_to(position, 35, occupancy(position)), E4 | E6 | B6 | C3 | F6);
+	assert_equals("x-ray through e4", attackers_to(position, 35, occupancy(position) & ~E4) & ~E4,
+			E6 | B6 | C3 | F6 | F3);
+	assert_equals("white not in check", is_in_check(position, true), false);
+	fen_info = parse_fen("6k1/pp3pp1/4p2p/8/3P3P/3R2P1/q1K5/4R3 w - - 2 37");
+	assert_equals("white in check", is_in_check(fen_info.position, true), true);
+	assert_equals("black not in check", is_in_check(fen_info.position, false), false);
+}
+
+void gives_checks() {
+	// the checks found by gives_check are the ones found by making the moves
+	const char* fens[] = { "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+			"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 b - -",
+			"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+			"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", "8/8/8/R2pP2k/8/8/8/K7 w - d6 0 1",
+			"5k2/8/8/8/8/8/8/4K2R w K - 0 1", "5r2/6P1/7k/8/8/8/8/K7 w - - 0 1" };
+	for (auto fen : fens) {
+		FenInfo fen_info = parse_fen(fen);
+		Position& position = fen_info.position;
+		CheckInfo info = check_info(position, fen_info.white_turn);
+		for (auto move : get_legal_moves(position, fen_info.white_turn)) {
+			bool check = gives_check(position, info, move.m);
+			make_move(position, move);
+			assert_equals((std::string(fen) + " " + uci_move(move.m)).c_str(), check,
+					is_in_check(position, !fen_info.white_turn));
+			unmake_move(position, move);
+		}
+	}
+	FenInfo fen_info = parse_fen("8/8/8/R2pP2k/8/8/8/K7 w - d6 0 1");
+	CheckInfo info = check_info(fen_info.position, true);
+	for (auto move : get_legal_moves(fen_info.position, true)) {
+		if (captured_piece(move.m) == EN_PASSANT) {
+			assert_equals("en passant discovers the rook", gives_check(fen_info.position, info, move.m), true);
+		}
+	}
+}
+
+void quiet_checks() {
+	FenInfo fen_info = parse_fen("4k3/8/8/8/8/8/8/R3K3 w - - 0 1");
+	MoveList checks = get_quiet_checks(fen_info.position, true, check_info(fen_info.position, true));
+	assert_equals("rook check", checks.size(), 1);
+	assert_equals("rook to the last row", uci_move(checks[0].m) == "a1a8", true);
+	fen_info = parse_fen("4k3/8/8/8/4N3/8/8/4R1K1 w - - 0 1");
+	assert_equals("discovered checks", get_quiet_checks(fen_info.position, true, check_info(fen_info.position, true)).size(), 8);
+	fen_info = parse_fen("4k3/8/3P4/8/8/8/8/4K3 w - - 0 1");
+	assert_equals("pawn check", get_quiet_checks(fen_info.position, true, check_info(fen_info.position, true)).size(), 1);
+	fen_info = parse_fen("4k3/8/8/8/8/8/8/4K3 b - - 0 1");
+	assert_equals("no checks", get_quiet_checks(fen_info.position, false, check_info(fen_info.position, false)).size(), 0);
+
+	// the same quiet checks as found by making the moves
+	const char* fens[] = { "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+			"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 b - -",
+			"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+			"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", "4k3/8/8/2P5/4N3/8/1B6/4R1K1 w - - 0 1" };
+	for (auto fen : fens) {
+		fen_info = parse_fen(fen);
+		Position& position = fen_info.position;
+		checks = get_quiet_checks(position, fen_info.white_turn, check_info(position, fen_info.white_turn));
+		unsigned int check_count = 0;
+		for (auto move : get_moves(position, fen_info.white_turn)) {
+			if (is_capture(move.m) || is_promotion(move.m) || is_castling(move.m)) {
+				continue;
+			}
+			make_move(position, move);
+			bool gives_check = check_info(position, !fen_info.white_turn).checkers != 0;
+			unmake_move(position, move);
+			if (gives_check) {
+				check_count++;
+				bool found = false;
+				for (auto check : checks) {
+					found = found || check.m == move.m;
+				}
+				assert_equals(("quiet check " + uci_move(move.m)).c_str(), found, true);
+			}
+		}
+		assert_equals(("quiet checks in " + std::string(fen)).c_str(), checks.size(), check_count);
+	}
+}
+
+void see_quiet_moves() {
+	// the queen is lost on the squares attacked by the pawn, a quiet move to a safe square loses nothing
+	FenInfo fen_info = parse_fen("4k3/8/8/1p6/8/8/8/3QK3 w - - 0 1");
+	for (auto move : get_legal_moves(fen_info.position, true)) {
+		if (uci_move(move.m) == "d1c2") {
+			assert_equals("safe quiet move", see(fen_info.position, move), 0);
+		}
+		if (uci_move(move.m) == "d1a4") {
+			assert_equals("quiet move to an attacked square", see(fen_info.position, move) == -900, true);
+		}
+	}
+	// the queen captures the checking rook on a8
+	fen_info = parse_fen("4k3/1q6/8/8/8/8/R7/4K3 w - - 0 1");
+	for (auto move : get_legal_moves(fen_info.position, true)) {
+		if (uci_move(move.m) == "a2a8") {
+			assert_equals("the checking rook is captured", see(fen_info.position, move) == -500, true);
+		}
+		if (uci_move(move.m) == "a2e2") {
+			assert_equals("safe check", see(fen_info.position, move), 0);
+		}
+	}
+}
+
 void perft_test()  {
 	FenInfo fen_info = parse_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"); // startpos
 	Position position = fen_info.position;
@@ -317,9 +596,271 @@ void fen_en_passant() {
 	assert_equals("one en passant capture", moves.size(), 1);
 }
 
-void run_tests() {
-	init();
+void fast_perft_test() {
+	FenInfo fen_info = parse_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -");
+	assert_equals("kiwipete depth 1", fast_perft(fen_info.position, 1, fen_info.white_turn, 1, 1024, false), 48);
+	assert_equals("kiwipete depth 3", fast_perft(fen_info.position, 3, fen_info.white_turn, 1, 1024, false), 97862);
+	assert_equals("kiwipete depth 4, 3 threads", fast_perft(fen_info.position, 4, fen_info.white_turn, 3, 65536, false),
+			4085603);
+
+	// castling rights and en passant captures after transpositions
+	fen_info = parse_fen("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1");
+	assert_equals("position 3 depth 5", fast_perft(fen_info.position, 5, fen_info.white_turn, 2, 65536, false), 674624);
+	fen_info = parse_fen("r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1");
+	assert_equals("position 4 depth 4", fast_perft(fen_info.position, 4, fen_info.white_turn, 2, 65536, false), 422333);
+	fen_info = parse_fen("r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10");
+	assert_equals("position 6 depth 4", fast_perft(fen_info.position, 4, fen_info.white_turn, 2, 65536, false), 3894594);
+}
+
+void lockless_transposition_table() {
+	Transposition* tt = new Transposition[hash_size];
+	uint64_t hash_key = 0x123456789abcdef0ULL;
+	TTData t;
+	t.next_move = to_capture_move(lsb_to_square(E4), lsb_to_square(D5), PAWN, QUEEN, BLACK, EMPTY);
+	t.depth = 12;
+	t.type = TT_TYPE_UPPER_BOUND;
+	t.score = -9999;
+	t.generation = 42;
+	store_tt(tt, hash_key, t);
+
+	TTData hit;
+	assert_equals("hit after store", probe_tt(tt, hash_key, hit), true);
+	assert_equals("next move", hit.next_move, t.next_move);
+	assert_equals("depth", hit.depth, 12);
+	assert_equals("type", hit.type, TT_TYPE_UPPER_BOUND);
+	assert_equals("negative score", hit.score == -9999, true);
+	assert_equals("generation", hit.generation, 42);
+	assert_equals("miss for other key", probe_tt(tt, hash_key ^ (1ULL << 40), hit), false);
+
+	// simulate a torn write, the data word from another entry
+	uint64_t index = tt_bucket_start_index(hash_key);
+	t.depth = 3;
+	for (int i = 0; i < TT_BUCKET_SIZE; i++) {
+		tt[index + i].data = pack_tt_data(t);
+	}
+	assert_equals("torn entry is a miss", probe_tt(tt, hash_key, hit), false);
+	delete[] tt;
+}
+
+void command_queue() {
+	CommandQueue queue;
+	Command command;
+	assert_equals("empty queue", queue.try_pop(command), false);
+	// wrap around the ring a few times
+	int pushed = 0;
+	int popped = 0;
+	bool in_order = true;
+	for (int round = 0; round < 3; round++) {
+		while (true) {
+			Command c;
+			c.line = "go depth " + std::to_string(pushed);
+			c.sequence = pushed;
+			if (!queue.try_push(c)) {
+				break;
+			}
+			pushed++;
+		}
+		while (queue.try_pop(command)) {
+			in_order = in_order && command.sequence == (uint64_t) popped
+					&& command.line == "go depth " + std::to_string(popped);
+			popped++;
+		}
+	}
+	assert_equals("all popped", popped, pushed);
+	assert_equals("fifo order", in_order, true);
+	assert_equals("full queue holds 256", pushed, 3 * 256);
+}
+
+void shared_transposition_table() {
+	std::string name = "/gunborg_test_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+	remove_shared_tt(name);
+	uint64_t size = hash_size;
+	Transposition* tt = attach_shared_tt(name, size);
+	assert_equals("create shared table", tt != NULL, true);
+	if (tt == NULL) {
+		return;
+	}
+	uint64_t hash_key = 0xfedcba9876543210ULL;
+	TTData t;
+	t.next_move = to_move(lsb_to_square(G1), lsb_to_square(F3), KNIGHT, WHITE, EMPTY);
+	t.depth = 7;
+	t.type = TT_TYPE_EXACT;
+	t.score = 35;
+	t.generation = 3;
+	store_tt(tt, hash_key, t);
+
+	// a second attach, like another process, asking for another size
+	uint64_t other_size = hash_size * 2;
+	Transposition* other = attach_shared_tt(name, other_size);
+	assert_equals("attach shared table", other != NULL, true);
+	assert_equals("size of the segment", other_size == hash_size, true);
+	TTData hit;
+	assert_equals("entry from the other mapping", other != NULL && probe_tt(other, hash_key, hit), true);
+	assert_equals("next move from the other mapping", hit.next_move, t.next_move);
+	detach_shared_tt(other, other_size);
+	detach_shared_tt(tt, size);
+
+	// attaching again does not clear the table
+	tt = attach_shared_tt(name, size);
+	assert_equals("entry kept after detach", tt != NULL && probe_tt(tt, hash_key, hit), true);
+	if (tt != NULL) {
+		detach_shared_tt(tt, size);
+	}
+	remove_shared_tt(name);
+}
+
+void uci_move_notation() {
+	assert_equals("quiet move", uci_move(to_move(lsb_to_square(G1), lsb_to_square(F3), KNIGHT, WHITE, EMPTY)) == "g1f3", true);
+	assert_equals("knight promotion", uci_move(to_capture_move(lsb_to_square(E7), lsb_to_square(D8), PAWN, ROOK, WHITE, KNIGHT)) == "e7d8n", true);
+	assert_equals("queen promotion", uci_move(to_move(lsb_to_square(A2), lsb_to_square(A1), PAWN, BLACK, QUEEN)) == "a2a1q", true);
+}
+
+void likely_replies() {
+	Transposition* tt = new Transposition[hash_size];
+	FenInfo fen_info = parse_fen("4k3/8/8/3q4/8/8/8/3QK3 w - - 0 1");
+	MoveList replies = gunborg::likely_replies(fen_info.position, fen_info.white_turn, tt, 3);
+	assert_equals("number of replies", replies.size(), 3);
+	assert_equals("queen capture most likely", uci_move(replies[0].m) == "d1d5", true);
+
+	// the best move in the transposition table is ranked first
+	TTData t;
+	t.next_move = to_move(lsb_to_square(E1), lsb_to_square(F2), KING, WHITE, EMPTY);
+	t.depth = 5;
+	t.type = TT_TYPE_EXACT;
+	t.score = 0;
+	t.generation = 0;
+	store_tt(tt, fen_info.position.hash_key, t);
+	replies = gunborg::likely_replies(fen_info.position, fen_info.white_turn, tt, 3);
+	assert_equals("tt move most likely", replies[0].m, t.next_move);
+	delete[] tt;
+}
+
+void move_picker() {
+	FenInfo fen_info = parse_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -"); // "kiwipete"
+	Position& position = fen_info.position;
+	MoveList moves = get_legal_moves(position, true);
+	uint32_t hash_move = to_move(lsb_to_square(A2), lsb_to_square(A3), PAWN, WHITE, EMPTY);
+	Move killers[2];
+	killers[0].m = to_move(lsb_to_square(G2), lsb_to_square(G3), PAWN, WHITE, EMPTY);
+	// a killer from another position, there is no queen on d1
+	killers[1].m = to_move(lsb_to_square(D1), lsb_to_square(D3), QUEEN, WHITE, EMPTY);
+	uint64_t history[64][64] = {};
+	assert_equals("pseudo legal hash move", is_pseudo_legal(position, true, hash_move), true);
+	assert_equals("pseudo legal killer", is_pseudo_legal(position, true, killers[0].m), true);
+	assert_equals("killer from another position", is_pseudo_legal(position, true, killers[1].m), false);
+	assert_equals("black move", is_pseudo_legal(position, false, hash_move), false);
+
+	CheckInfo check = check_info(position, true);
+	gunborg::MovePicker picker(position, true, check, hash_move, killers, history);
+	Move move;
+	MoveList picked;
+	while (picker.next_move(move)) {
+		picked.push_back(move);
+	}
+	assert_equals("all moves picked", picked.size(), moves.size());
+	for (auto m : moves) {
+		int count = 0;
+		for (auto p : picked) {
+			count += p.m == m.m;
+		}
+		assert_equals(("picked once " + uci_move(m.m)).c_str(), count, 1);
+	}
+	assert_equals("hash move first", picked[0].m, hash_move);
+	bool killer_picked = false;
+	for (unsigned int i = 1; i < picked.size(); i++) {
+		killer_picked = killer_picked || picked[i].m == killers[0].m;
+		if (!is_capture(picked[i].m) && picked[i].m != killers[0].m) {
+			assert_equals("killer before quiet moves", killer_picked, true);
+		}
+	}
+	// Qxh3 is defended by the bishop on g7
+	assert_equals("losing capture last", uci_move(picked.back().m) == "f3h3", true);
+
+	gunborg::MovePicker split_picker(position, true, check, hash_move, killers, history);
+	split_picker.next_move(move);
+	split_picker.next_move(move);
+	MoveList remaining;
+	split_picker.remaining_moves(remaining);
+	assert_equals("remaining moves", remaining.size() + 2, moves.size());
+	assert_equals("no moves left", split_picker.next_move(move), false);
+
+	fen_info = parse_fen("6k1/pp3pp1/4p2p/8/3P3P/3R2P1/q1K5/4R3 w - - 2 37");
+	check = check_info(fen_info.position, true);
+	gunborg::MovePicker evasion_picker(fen_info.position, true, check, hash_move, killers, history);
+	unsigned int evasions = 0;
+	while (evasion_picker.next_move(move)) {
+		evasions++;
+	}
+	assert_equals("evasions picked", evasions, 3);
+}
+
+/*
+ * the attack set of a slider by walking the rays, to check the lookup of the attack backend
+ */
+uint64_t walk_attacks(uint64_t occupied_squares, int square, const int (&directions)[4][2]) {
+	uint64_t attacks = 0;
+	for (auto& direction : directions) {
+		int file = square % 8 + direction[0];
+		int rank = square / 8 + direction[1];
+		for (; file >= 0 && file < 8 && rank >= 0 && rank < 8; file += direction[0], rank += direction[1]) {
+			attacks |= 1ULL << (rank * 8 + file);
+			if (occupied_squares & (1ULL << (rank * 8 + file))) {
+				break;
+			}
+		}
+	}
+	return attacks;
+}
+
+void slider_attacks() {
+	const int BISHOP_DIRECTIONS[4][2] = { { 1, 1 }, { 1, -1 }, { -1, 1 }, { -1, -1 } };
+	const int ROOK_DIRECTIONS[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+	// both tables, the pext table only if the cpu has pext
+	const char* backend = attack_backend();
+	for (int pext = 0; pext < 2; pext++) {
+		set_pext_attacks(pext);
+		uint64_t seed = 1;
+		bool all_equal = true;
+		for (int i = 0; i < 1000; i++) {
+			seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+			uint64_t occupied_squares = seed & (seed << 17) & (seed >> 9);
+			for (int square = 0; square < 64; square++) {
+				all_equal = all_equal && bishop_attacks(occupied_squares, square)
+						== walk_attacks(occupied_squares, square, BISHOP_DIRECTIONS);
+				all_equal = all_equal && rook_attacks(occupied_squares, square)
+						== walk_attacks(occupied_squares, square, ROOK_DIRECTIONS);
+			}
+		}
+		assert_equals((std::string("slider attacks ") + attack_backend()).c_str(), all_equal, true);
+	}
+	set_pext_attacks(std::string(backend) == "pext");
+}
 
+void slider_attack_map_fill() {
+	uint64_t seed = 7;
+	bool all_equal = true;
+	for (int i = 0; i < 10000; i++) {
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		uint64_t occupied_squares = seed & (seed << 13);
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		uint64_t diagonal_sliders = occupied_squares & seed & (seed >> 7);
+		uint64_t straight_sliders = occupied_squares & ~seed & (seed >> 11);
+		uint64_t attacks = 0;
+		for (uint64_t b = diagonal_sliders; b; b = reset_lsb(b)) {
+			attacks |= bishop_attacks(occupied_squares, lsb_to_square(b));
+		}
+		for (uint64_t b = straight_sliders; b; b = reset_lsb(b)) {
+			attacks |= rook_attacks(occupied_squares, lsb_to_square(b));
+		}
+		all_equal = all_equal && slider_attack_map(diagonal_sliders, straight_sliders, occupied_squares) == attacks
+				&& sse2_slider_attack_map(diagonal_sliders, straight_sliders, occupied_squares) == attacks;
+	}
+	assert_equals((std::string("slider attack map ") + slider_attack_map_backend()).c_str(), all_equal, true);
+}
+
+void run_tests() {
+	slider_attacks();
+	slider_attack_map_fill();
 	white_pawn_push();
 	white_blocked_pawn_push();
 	black_pawn_push();
@@ -330,6 +871,9 @@ void run_tests() {
 	make_unmake();
 	make_unmake_capture();
 	make_unmake_king_capture();
+	zobrist_keys();
+	incremental_occupancy_and_board();
+	incremental_attacks();
 	white_knight_moves();
 	start_moves();
 	white_castling();
@@ -341,6 +885,19 @@ void run_tests() {
 	perft_test();
 
 	forced_move();
+	legal_moves();
+	attackers();
+	gives_checks();
+	quiet_checks();
+	see_quiet_moves();
+
+	fast_perft_test();
+	lockless_transposition_table();
+	command_queue();
+	shared_transposition_table();
+	uci_move_notation();
+	likely_replies();
+	move_picker();
 
 	std::cout << test_count << " tests executed" << std::endl;
 }
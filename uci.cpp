@@ -21,14 +21,23 @@
  *      Author: Torbjörn Nilsson
  */
 
+#include "bench.h"
 #include "board.h"
+#include "Cluster.h"
+#include "CommandQueue.h"
+#include "magic.h"
 #include "moves.h"
+#include "numa.h"
+#include "perft.h"
 #include "Search.h"
+#include "shared_hash.h"
 #include "uci.h"
 #include "util.h"
+#include <algorithm>
 #include <atomic>
 #include <iostream>
 #include <limits.h>
+#include <mutex>
 #include <thread>
 #include <vector>
 #include <stdlib.h>
@@ -39,6 +48,162 @@ namespace {
 
 const char* VERSION = "1.65";
 const int DEFAULT_HASH_SIZE_MB = 16;
+const int MAX_THREADS = 64;
+const int MAX_PONDER_REPLIES = 8;
+
+// commands from the stdin reader to the engine thread
+CommandQueue commands;
+// sequence number of the last stop (or go, quit), searches of earlier go commands should stop
+std::atomic<uint64_t> stop_sequence(0);
+// sequence number of the last ponderhit
+std::atomic<uint64_t> ponderhit_sequence(0);
+// sequence number of the last command executed by the engine thread, a go as soon as its search has started
+std::atomic<uint64_t> done_sequence(0);
+
+// name of the shared memory segment of the transposition table, empty for a table of this process only
+string shared_hash_name;
+// true if the current table is mapped from the shared memory segment
+bool tt_shared = false;
+
+/*
+ * the shared table if the Shared Hash option is set, otherwise a new empty table
+ */
+Transposition* new_tt(int threads) {
+	tt_shared = false;
+	if (!shared_hash_name.empty()) {
+		Transposition* tt = attach_shared_tt(shared_hash_name, hash_size);
+		if (tt != NULL) {
+			tt_shared = true;
+			return tt;
+		}
+		cout << "info string could not attach shared hash " << shared_hash_name << "\n" << flush;
+	}
+	return allocate_tt(hash_size, threads);
+}
+
+void delete_tt(Transposition* tt) {
+	if (tt_shared) {
+		detach_shared_tt(tt, hash_size);
+	} else {
+		free_tt(tt, hash_size);
+	}
+}
+
+/*
+ * the moves after searchmoves in a go command
+ */
+vector<string> parse_search_moves(const string& line) {
+	vector<string> search_moves;
+	string::size_type pos = line.find("searchmoves");
+	if (pos == string::npos) {
+		return search_moves;
+	}
+	string moves_str = line.substr(pos + 11);
+	for (auto token : split(moves_str)) {
+		if ((token.size() == 4 || token.size() == 5) && token[0] >= 'a' && token[0] <= 'h' && token[1] >= '1'
+				&& token[1] <= '8' && token[2] >= 'a' && token[2] <= 'h' && token[3] >= '1' && token[3] <= '8') {
+			search_moves.push_back(token);
+		}
+	}
+	return search_moves;
+}
+
+/*
+ * the legal moves of the position, only the moves in search_moves if it is not empty
+ */
+vector<string> legal_root_moves(Position& position, bool white_turn, const vector<string>& search_moves) {
+	vector<string> root_moves;
+	MoveList moves = get_legal_moves(position, white_turn);
+	for (auto move : moves) {
+		string move_str = uci_move(move.m);
+		if (search_moves.empty() || find(search_moves.begin(), search_moves.end(), move_str) != search_moves.end()) {
+			root_moves.push_back(move_str);
+		}
+	}
+	return root_moves;
+}
+
+/*
+ * a reply the gui did not ask to ponder on, searched silently while pondering
+ */
+struct Speculation {
+	gunborg::Search* search;
+	thread* search_thread;
+	uint64_t hash_key;
+};
+
+/*
+ * root moves ordered by a speculative search, for the real search of the same position
+ */
+struct WarmStart {
+	uint64_t hash_key;
+	MoveList root_moves;
+};
+
+/*
+ * Starts searches of the most likely replies in before_reply, other than the reply in ponder_position that
+ * the gui ponders on. count includes the reply of the gui. All searches share the transposition table.
+ */
+vector<Speculation> start_speculations(const Position& ponder_position, const Position& before_reply, bool white_turn,
+		const list& history, Transposition* tt, int count, int generation) {
+	vector<Speculation> speculations;
+	Position position = before_reply;
+	MoveList replies = gunborg::likely_replies(position, !white_turn, tt, count);
+	for (auto reply : replies) {
+		if ((int) speculations.size() == count - 1) {
+			break;
+		}
+		make_move(position, reply);
+		Position reply_position = position;
+		unmake_move(position, reply);
+		if (reply_position.hash_key == ponder_position.hash_key) {
+			continue;
+		}
+		Speculation speculation;
+		speculation.search = new gunborg::Search();
+		speculation.search->speculative = true;
+		speculation.search->quiet = true;
+		speculation.search->should_run = true;
+		speculation.search->max_think_time_ms = INT_MAX;
+		speculation.search->generation = generation;
+		speculation.hash_key = reply_position.hash_key;
+		speculation.search_thread = new thread(&gunborg::Search::search_best_move, speculation.search, reply_position,
+				white_turn, history, tt);
+		speculations.push_back(speculation);
+	}
+	return speculations;
+}
+
+// the speculative searches of the running ponder search, and the root moves of the stopped ones for the next
+// search. The reader stops the speculations at ponderhit or stop, the engine thread after the ponder search
+std::mutex speculations_lock;
+vector<Speculation> speculations;
+vector<WarmStart> warm_starts;
+
+/*
+ * stops the speculative searches and keeps their root move order
+ */
+void stop_speculations() {
+	std::lock_guard<std::mutex> guard(speculations_lock);
+	for (auto speculation : speculations) {
+		speculation.search->should_run = false;
+		speculation.search_thread->join();
+		WarmStart warm_start;
+		warm_start.hash_key = speculation.hash_key;
+		warm_start.root_moves = speculation.search->searched_root_moves;
+		warm_starts.push_back(warm_start);
+		delete speculation.search_thread;
+		delete speculation.search;
+	}
+	speculations.clear();
+}
+
+/*
+ * option values may contain "go"
+ */
+bool is_go_command(const string& line) {
+	return line.find("go") != string::npos && line.find("setoption") == string::npos;
+}
 
 }
 
@@ -131,7 +296,11 @@ FenInfo parse_fen(string fen) {
 		uint64_t en_passant_square = 1ULL << (8 * (en_passant[1] - '0' -1) + en_passant[0] - 'a');
 		meta_info |= en_passant_square;
 	}
-	position.meta_info_stack.push_back(meta_info);
+	init_position(position);
+	current_state(position).meta_info = meta_info;
+	if (fen_strs.size() > 4) {
+		current_state(position).halfmove_clock = atoi(fen_strs[4].c_str());
+	}
 
 	FenInfo fen_info;
 	fen_info.position = position;
@@ -141,6 +310,7 @@ FenInfo parse_fen(string fen) {
 		fen_info.white_turn = false;
 	}
 
+	fen_info.position.hash_key = zobrist_key(fen_info.position, fen_info.white_turn);
 	if (fen_strs.size() > 4) {
 		fen_info.move = atoi(fen_strs[5].c_str());
 	}
@@ -156,18 +326,12 @@ void update_with_move(Position& position, string move_str, bool white_turn) {
 	int to_row = move_str[3] - '0';
 	int to = (to_row - 1) * 8 + to_file - 1;
 
-	uint64_t black_squares = position.p[BLACK][KING] | position.p[BLACK][PAWN] | position.p[BLACK][KNIGHT]
-			| position.p[BLACK][BISHOP] | position.p[BLACK][ROOK] | position.p[BLACK][QUEEN];
-
-	uint64_t white_squares = position.p[WHITE][KING] | position.p[WHITE][PAWN] | position.p[WHITE][KNIGHT]
-			| position.p[WHITE][BISHOP] | position.p[WHITE][ROOK] | position.p[WHITE][QUEEN];
-
-	uint64_t occupied_squares = black_squares | white_squares;
+	uint64_t occupied_squares = occupancy(position);
 
 	uint64_t from_square = 1ULL << from;
 	uint64_t to_square = 1ULL << to;
 
-	uint64_t meta_info = position.meta_info_stack.back();
+	uint64_t meta_info = current_state(position).meta_info;
 
 	Move move;
 	int promotion = EMPTY;
@@ -209,50 +373,115 @@ void update_with_move(Position& position, string move_str, bool white_turn) {
 	}
 
 	make_move(position, move);
+	// the moves of the game are never unmade, only the current state is kept so long games fit in the states
+	position.states[0] = current_state(position);
+	position.ply = 0;
 }
 
-void uci() {
-	thread* search_thread = NULL;
-
+/*
+ * Executes the commands from the stdin reader in order. Searches run on this thread, stop and ponderhit are
+ * handled by the reader while a search is running.
+ */
+void process_commands(gunborg::Search* search) {
 	FenInfo fen_info =  start_pos();
 	Position start_position = fen_info.position;
 	bool white_turn = fen_info.white_turn;
 	int move = fen_info.move;
 
-	gunborg::Search* search = NULL;
+	int threads = 1;
+	gunborg::SmpMode smp_mode = gunborg::LAZY_SMP;
+	// the workers of cluster searches, and the position command they are sent
+	gunborg::Cluster cluster;
+	string position_line = "position startpos";
+	// replies searched while pondering, besides the one the gui ponders on
+	int ponder_replies = 1;
 	list history;
-	Transposition * tt = new Transposition[hash_size];
+	Transposition * tt = new_tt(threads);
+	uint64_t last_sequence = 0;
 	while (true) {
-		string line;
-		getline(cin, line);
+		done_sequence = last_sequence;
+		Command command = commands.pop();
+		last_sequence = command.sequence;
+		string line = command.line;
 		if (line.find("uci") != string::npos) {
 			cout << "id name gunborg " << VERSION << "\n";
 			cout << "id author Torbjorn Nilsson\n";
 			cout << "option name Hash type spin default " << DEFAULT_HASH_SIZE_MB << " min 1 max 1024\n";
 			cout << "option name Ponder type check default false\n";
+			cout << "option name Threads type spin default 1 min 1 max " << MAX_THREADS << "\n";
+			cout << "option name SMP Mode type combo default LazySMP var LazySMP var YBW\n";
+			cout << "option name Thread Affinity type combo default none var none var core var node\n";
+			cout << "option name Shared Hash type string default <empty>\n";
+			cout << "option name Cluster Workers type string default <empty>\n";
+			cout << "option name Ponder Replies type spin default 1 min 1 max " << MAX_PONDER_REPLIES << "\n";
 			cout << "uciok\n" << flush;
 		}
-		if (line.find("isready") != string::npos) {
-			cout << "readyok\n" << flush;
-		}
 		if (line.find("ucinewgame") != string::npos) {
 			// new game
 			FenInfo fen_info = start_pos();
 			start_position = fen_info.position;
 			white_turn = fen_info.white_turn;
 			move = fen_info.move;
-			delete[] tt;
-			tt = new Transposition[hash_size];
+			// clears the table, a shared table is kept since other processes use it
+			delete_tt(tt);
+			tt = new_tt(threads);
+			position_line = "position startpos";
+			for (int i = 0; i < cluster.size(); i++) {
+				cluster.send(i, "ucinewgame");
+			}
 		}
 		if (line.find("setoption name Hash") != string::npos) {
 			int hash_size_in_mb = parse_int_parameter(line, "value");
+			delete_tt(tt);
 			if (hash_size_in_mb >= 1 && hash_size_in_mb <= 1024) {
 				hash_size = get_hash_table_size(hash_size_in_mb);
 			}
-			delete[] tt;
-			tt = new Transposition[hash_size];
+			tt = new_tt(threads);
+		}
+		if (line.find("setoption name Threads") != string::npos) {
+			int no_threads = parse_int_parameter(line, "value");
+			if (no_threads >= 1 && no_threads <= MAX_THREADS) {
+				threads = no_threads;
+			}
+			// spread the table over the nodes of the threads
+			delete_tt(tt);
+			tt = new_tt(threads);
+		}
+		if (line.find("setoption name Thread Affinity") != string::npos) {
+			set_affinity_mode(parse_affinity_mode(line));
+			delete_tt(tt);
+			tt = new_tt(threads);
+		}
+		if (line.find("setoption name Shared Hash") != string::npos) {
+			// the segment is attached by all processes with the same name, the first one decides the size
+			string::size_type pos = line.find("value");
+			string name = pos != string::npos && pos + 6 < line.size() ? line.substr(pos + 6) : "";
+			delete_tt(tt);
+			shared_hash_name = name == "<empty>" ? "" : name;
+			tt = new_tt(threads);
+		}
+		if (line.find("setoption name Cluster Workers") != string::npos) {
+			// comma separated unix socket paths or [host:]port of processes started with "gunborg worker"
+			string::size_type pos = line.find("value");
+			string addresses = pos != string::npos && pos + 6 < line.size() ? line.substr(pos + 6) : "";
+			if (addresses == "<empty>") {
+				addresses = "";
+			}
+			if (!cluster.connect(addresses)) {
+				cout << "info string could not connect to cluster workers " << addresses << "\n" << flush;
+			}
+		}
+		if (line.find("setoption name Ponder Replies") != string::npos) {
+			int replies = parse_int_parameter(line, "value");
+			if (replies >= 1 && replies <= MAX_PONDER_REPLIES) {
+				ponder_replies = replies;
+			}
+		}
+		if (line.find("setoption name SMP Mode") != string::npos) {
+			smp_mode = line.find("YBW") != string::npos ? gunborg::YBW : gunborg::LAZY_SMP;
 		}
 		if (line.find("position") != string::npos) {
+			position_line = line;
 			history.clear();
 			// parse position
 			// position [fen <fenstring> | startpos ]  moves <move1> .... <movei>
@@ -285,20 +514,12 @@ void uci() {
 				}
 			}
 		}
-		if (line.find("go") != string::npos) {
-			if (search_thread != NULL) {
-				search->should_run = false;
-				search_thread->join();
-				delete search_thread;
-				search_thread = NULL;
-			}
-			if (search != NULL) {
-				delete search;
-				search = NULL;
-			}
-			search = new gunborg::Search();
+		if (is_go_command(line)) {
+			search->reset();
 			search->should_run = true;
 			search->generation = move;
+			search->threads = threads;
+			search->smp_mode = smp_mode;
 
 			int depth = parse_int_parameter(line, "depth");
 			if (depth != 0 ) {
@@ -333,59 +554,127 @@ void uci() {
 			if (line.find("ponder") != string::npos) {
 				search->ponder();
 			}
-			search_thread = new thread(&gunborg::Search::search_best_move, search, start_position, white_turn, history, tt);
-		}
-		if (line.find("ponderhit") != string::npos) {
-			search->ponder_hit();
-		}
-		if (line.find("stop") != string::npos) {
-			if (search_thread != NULL) {
+			search->search_moves = parse_search_moves(line);
+			if (cluster.size() > 0) {
+				// divide the root moves between this process and the workers
+				vector<string> root_moves = legal_root_moves(start_position, white_turn, search->search_moves);
+				int participants = cluster.size() + 1;
+				vector<vector<string> > shares(participants);
+				for (unsigned int i = 0; i < root_moves.size(); i++) {
+					shares[i % participants].push_back(root_moves[i]);
+				}
+				cluster.clear_results();
+				for (int i = 0; i < cluster.size(); i++) {
+					if (shares[i + 1].empty()) {
+						continue;
+					}
+					// this process decides when the workers stop
+					string go_line = "go infinite";
+					if (depth != 0) {
+						go_line += " depth " + to_string(search->max_depth);
+					}
+					go_line += " searchmoves";
+					for (auto root_move : shares[i + 1]) {
+						go_line += " " + root_move;
+					}
+					cluster.start(i, position_line, go_line);
+				}
+				search->search_moves = shares[0];
+				search->cluster = &cluster;
+			}
+			// the reader may have seen stop or ponderhit before this search started
+			if (stop_sequence > command.sequence) {
 				search->should_run = false;
-				search_thread->join();
-				delete search_thread;
-				search_thread = NULL;
 			}
+			if (ponderhit_sequence > command.sequence) {
+				search->ponder_hit();
+			}
+			{
+				std::lock_guard<std::mutex> guard(speculations_lock);
+				for (auto warm_start : warm_starts) {
+					if (warm_start.hash_key == start_position.hash_key) {
+						// the opponent played one of the replies searched while pondering
+						search->warm_start_moves = warm_start.root_moves;
+					}
+				}
+				warm_starts.clear();
+				if (line.find("ponder") != string::npos && ponder_replies > 1 && !history.empty()) {
+					speculations = start_speculations(start_position, history.back(), white_turn, history, tt,
+							ponder_replies, move);
+				}
+			}
+			if (stop_sequence > command.sequence || ponderhit_sequence > command.sequence) {
+				// the reader may have seen stop or ponderhit before the speculations were started
+				stop_speculations();
+			}
+			done_sequence = command.sequence;
+			search->search_best_move(start_position, white_turn, history, tt);
+			stop_speculations();
 		}
 		if (line.find("quit") != string::npos) {
-			delete[] tt;
+			delete_tt(tt);
 			return;
 		}
 		// non uci commands
 		if (line.find("perft") != string::npos) {
+			// perft [depth <depth>] [divide], with the threads and hash size of the search
 			std::chrono::high_resolution_clock clock;
 			std::chrono::high_resolution_clock::time_point start;
 
 			int depth = parse_int_parameter(line, "depth");
 			depth = depth == 0 ? 5 : depth;
 
-			for (int i = 1; i <= depth; i++) {
-				start = clock.now();
-				std::cout << "perft depth(" << i << ") nodes: "
-						<< perft(start_position, i, white_turn);
-				int time_elapsed = std::chrono::duration_cast
-						< std::chrono::milliseconds > (clock.now() - start).count();
-				std::cout << " in " << time_elapsed << " ms\n";
+			if (line.find("divide") != string::npos) {
+				fast_perft(start_position, depth, white_turn, threads, hash_size, true);
+			} else {
+				for (int i = 1; i <= depth; i++) {
+					start = clock.now();
+					std::cout << "perft depth(" << i << ") nodes: "
+							<< fast_perft(start_position, i, white_turn, threads, hash_size, false);
+					int time_elapsed = std::chrono::duration_cast
+							< std::chrono::milliseconds > (clock.now() - start).count();
+					std::cout << " in " << time_elapsed << " ms\n";
+				}
 			}
 		}
-		if (line.find("bench") != string::npos) {
-			delete[] tt;
-			tt = new Transposition[get_hash_table_size(DEFAULT_HASH_SIZE_MB)];
+		if (line.find("bench smp") != string::npos) {
+			// bench smp [depth <depth>] [threads <max threads>], csv with the scaling from 1 to max threads
+			int depth = parse_int_parameter(line, "depth");
+			int max_threads = parse_int_parameter(line, "threads");
+			bench_smp(max_threads >= 1 && max_threads <= MAX_THREADS ? max_threads : threads, depth > 0 ? depth : 8,
+					smp_mode);
+		} else if (line.find("bench numa") != string::npos) {
+			// bench numa [depth <depth>], nps with each thread affinity at the configured threads
+			int depth = parse_int_parameter(line, "depth");
+			bench_numa(threads, depth > 0 ? depth : 8, smp_mode);
+		} else if (line.find("bench attacks") != string::npos) {
+			bench_attacks();
+		} else if (line.find("bench") != string::npos) {
+			delete_tt(tt);
+			tt = new_tt(threads);
 			history.clear();
-			if (search != NULL) {
-				delete search;
-				search = NULL;
-			}
-			search = new gunborg::Search();
-			search->should_run = true;
-			search->max_depth = 10;
-			search->max_think_time_ms = 60000;
+			// a search of its own, the bench is not stopped by stop or quit
+			gunborg::Search bench_search;
+			bench_search.should_run = true;
+			bench_search.max_depth = 10;
+			bench_search.max_think_time_ms = 60000;
+			bench_search.threads = threads;
+			bench_search.smp_mode = smp_mode;
 			fen_info = parse_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -");
 			std::chrono::high_resolution_clock clock;
 			std::chrono::high_resolution_clock::time_point start = clock.now();
-			search->search_best_move(fen_info.position, fen_info.white_turn, history, tt);
+			bench_search.search_best_move(fen_info.position, fen_info.white_turn, history, tt);
 			int time_elapsed = std::chrono::duration_cast
 									< std::chrono::milliseconds > (clock.now() - start).count();
-			std::cout << "bench " << search->node_count << " nodes in " << time_elapsed << " ms\n";
+			uint64_t nodes = bench_search.total_node_count();
+			std::cout << "bench " << nodes << " nodes (" << bench_search.total_qnode_count() << " qsearch nodes) in "
+					<< time_elapsed << " ms";
+			if (time_elapsed > 0) {
+				std::cout << " (" << nodes * 1000 / time_elapsed << " nps, " << threads << " threads)";
+			}
+			std::cout << "\n";
+			std::cout << "cpu features: " << cpu_features() << ", slider attacks " << attack_backend() << "\n";
+			print_numa_info(tt, hash_size, threads);
 		}
 		// license info
 		if (line.find("show w") != string::npos) {
@@ -403,3 +692,62 @@ void uci() {
 	}
 }
 
+
+/*
+ * Reads commands from stdin. isready, stop and ponderhit are answered here, also while a search is running,
+ * the other commands are queued for the engine thread. readyok is sent when the engine thread is done with the
+ * queued commands, or has started the search of a queued go.
+ */
+void uci() {
+	gunborg::Search search;
+	search.should_run = false;
+	stop_sequence = 0;
+	ponderhit_sequence = 0;
+	done_sequence = 0;
+	thread engine_thread(process_commands, &search);
+	uint64_t sequence = 0;
+	// sequence number of the last command queued for the engine thread
+	uint64_t queued_sequence = 0;
+	while (true) {
+		string line;
+		if (!getline(cin, line)) {
+			// end of input
+			line = "quit";
+		}
+		sequence++;
+		if (line.find("isready") != string::npos) {
+			// ready when the commands before isready are done, a running search does not delay the answer
+			while (done_sequence < queued_sequence) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			cout << "readyok\n" << flush;
+			continue;
+		}
+		if (line.find("ponderhit") != string::npos) {
+			ponderhit_sequence = sequence;
+			search.ponder_hit();
+			// the replies the gui did not ask for are not played, the real search gets all cores
+			stop_speculations();
+			continue;
+		}
+		if (line.find("stop") != string::npos || is_go_command(line)
+				|| line.find("quit") != string::npos) {
+			// a new go also stops the running search
+			stop_sequence = sequence;
+			search.should_run = false;
+			stop_speculations();
+		}
+		if (line.find("stop") != string::npos) {
+			continue;
+		}
+		Command command;
+		command.line = line;
+		command.sequence = sequence;
+		commands.push(command);
+		queued_sequence = sequence;
+		if (line.find("quit") != string::npos) {
+			break;
+		}
+	}
+	engine_thread.join();
+}
@@ -181,37 +181,22 @@ std::string long_algebraic_notation(uint64_t square) {
 	return "";
 }
 
+namespace {
+
+const char* PIECE_SYMBOLS[2][6] = { { "♙", "♘", "♗", "♖", "♕", "♔" }, { "♟", "♞", "♝", "♜", "♛", "♚" } };
+
+}
+
 void print_position(const Position& position) {
 	for (int i = 63; i >= 0; i--) {
 		int file = 7 - i % 8;
 		int row = i / 8;
-		uint64_t square = 1ULL << ((8 * row) + file);
-		if (position.p[WHITE][PAWN] & square) {
-			std::cout << "♙";
-		} else if (position.p[BLACK][PAWN] & square) {
-			std::cout << "♟";
-		} else if (position.p[WHITE][KING] & square) {
-			std::cout << "♔";
-		} else if (position.p[BLACK][KING] & square) {
-			std::cout << "♚";
-		} else if (position.p[WHITE][BISHOP] & square) {
-			std::cout << "♗";
-		} else if (position.p[BLACK][BISHOP] & square) {
-			std::cout << "♝";
-		} else if (position.p[WHITE][ROOK] & square) {
-			std::cout << "♖";
-		} else if (position.p[BLACK][ROOK] & square) {
-			std::cout << "♜";
-		} else if (position.p[WHITE][QUEEN] & square) {
-			std::cout << "♕";
-		} else if (position.p[BLACK][QUEEN] & square) {
-			std::cout << "♛";
-		} else if (position.p[WHITE][KNIGHT] & square) {
-			std::cout << "♘";
-		} else if (position.p[BLACK][KNIGHT] & square) {
-			std::cout << "♞";
-		} else {
+		int square = (8 * row) + file;
+		if (position.board[square] == EMPTY) {
 			std::cout << ".";
+		} else {
+			int color = (position.color_squares[WHITE] & (1ULL << square)) ? WHITE : BLACK;
+			std::cout << PIECE_SYMBOLS[color][position.board[square]];
 		}
 		std::cout << " ";
 		if (i % 8 == 0) {
@@ -244,6 +229,15 @@ std::vector<std::string> split(std::string& line) {
 	return result;
 }
 
+std::string uci_move(uint32_t move) {
+	std::string move_str = long_algebraic_notation(1ULL << from_square(move))
+			+ long_algebraic_notation(1ULL << to_square(move));
+	if (is_promotion(move)) {
+		move_str += "pnbrqk"[promotion_piece(move)];
+	}
+	return move_str;
+}
+
 int parse_int_parameter(std::string line, std::string parameter) {
 	std::string::size_type pos = line.find(parameter);
 	if (pos != std::string::npos) {
@@ -256,18 +250,33 @@ int parse_int_parameter(std::string line, std::string parameter) {
 	return 0;
 }
 
-int perft(Position& position, const int depth, const bool white_turn) {
+uint64_t perft(Position& position, const int depth, const bool white_turn) {
 	if (depth == 0) {
 		return 1;
 	}
-	int nodes = 0;
-	MoveList moves = get_moves(position, white_turn);
+	uint64_t nodes = 0;
+	MoveList moves = get_legal_moves(position, white_turn);
 	for (auto it : moves) {
-		bool legal = make_move(position, it);
-		if (legal) {
-			nodes += perft(position, depth - 1, !white_turn);
-		}
+		make_move(position, it);
+		nodes += perft(position, depth - 1, !white_turn);
 		unmake_move(position, it);
 	}
 	return nodes;
 }
+
+std::string cpu_features() {
+	std::string features;
+#if defined(__GNUC__) && defined(__x86_64__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("popcnt")) {
+		features += "popcnt ";
+	}
+	if (__builtin_cpu_supports("bmi2")) {
+		features += "bmi2 ";
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		features += "avx2 ";
+	}
+#endif
+	return features.empty() ? "none" : features.substr(0, features.size() - 1);
+}
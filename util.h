@@ -32,6 +32,11 @@ std::string long_algebraic_notation(uint64_t square);
 
 std::string pvstring_from_stack(int * pv, int size);
 
+/*
+ * the move in uci notation, e.g. e7e8n
+ */
+std::string uci_move(uint32_t move);
+
 int parse_int_parameter(std::string line, std::string parameter);
 
 void print_position(const Position& position);
@@ -40,6 +45,11 @@ void print_bit_mask(uint64_t bit_mask);
 
 std::vector<std::string> split(std::string& line);
 
-int perft(Position& position, int depth, bool white_turn);
+uint64_t perft(Position& position, int depth, bool white_turn);
+
+/*
+ * the instruction set extensions of the cpu that the CPU_DISPATCH functions can use, e.g. "popcnt bmi2 avx2"
+ */
+std::string cpu_features();
 
 #endif /* UTIL_H_ */